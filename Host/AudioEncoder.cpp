@@ -0,0 +1,143 @@
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+#include "AudioEncoder.h"
+
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace lr {
+namespace AudioEncoder {
+
+
+namespace {
+
+
+/// The step sizes of the IMA ADPCM codec.
+///
+const int32_t cStepSizes[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+	253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+	3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+	12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/// The change of the step index for the lower three bits of a sample.
+///
+const int cStepIndexChanges[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+
+/// Encode one sample and update the state like the decoder.
+///
+uint8_t encodeImaAdpcmSample(int32_t sample, int32_t &predictor, int &stepIndex)
+{
+	const int32_t step = cStepSizes[stepIndex];
+	int32_t difference = sample - predictor;
+	uint8_t nibble = 0;
+	if (difference < 0) {
+		nibble = 8;
+		difference = -difference;
+	}
+	// Same calculation as the decoder, to keep the predictors in sync.
+	int32_t change = step >> 3;
+	if (difference >= step) {
+		nibble |= 4;
+		difference -= step;
+		change += step;
+	}
+	if (difference >= (step >> 1)) {
+		nibble |= 2;
+		difference -= step >> 1;
+		change += step >> 1;
+	}
+	if (difference >= (step >> 2)) {
+		nibble |= 1;
+		change += step >> 2;
+	}
+	if ((nibble & 8) != 0) {
+		predictor = std::max<int32_t>(-32768, predictor - change);
+	} else {
+		predictor = std::min<int32_t>(32767, predictor + change);
+	}
+	stepIndex = std::max(0, std::min(88, stepIndex + cStepIndexChanges[nibble & 7]));
+	return nibble;
+}
+
+
+}
+
+
+std::vector<uint8_t> quantize(const std::vector<float> &samples, SDCard::Codec codec, bool dither, uint32_t seed)
+{
+	const int levels = 1 << cDacBits;
+	const int shift = (codec == SDCard::Codec_Unsigned8) ? (8 - cDacBits) : 0;
+	std::vector<uint8_t> result(samples.size());
+	uint32_t random = seed | 1;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		float value = (samples[i] * 0.5f + 0.5f) * (levels - 1);
+		if (dither) {
+			// Triangular dither with an amplitude of one step.
+			random ^= random << 13; random ^= random >> 17; random ^= random << 5;
+			const float a = (random & 0xffff) / 65536.0f;
+			const float b = (random >> 16) / 65536.0f;
+			value += a - b;
+		}
+		const int level = std::max(0, std::min(levels - 1, static_cast<int>(std::lround(value))));
+		result[i] = static_cast<uint8_t>(level << shift);
+	}
+	return result;
+}
+
+
+std::vector<uint8_t> pack(std::vector<uint8_t> levels)
+{
+	levels.resize((levels.size() + 3) / 4 * 4, cSilence >> (8 - cDacBits));
+	std::vector<uint8_t> result;
+	result.reserve(levels.size() / 4 * 3);
+	for (size_t i = 0; i < levels.size(); i += 4) {
+		result.push_back(static_cast<uint8_t>(levels[i] | (levels[i + 1] << 6)));
+		result.push_back(static_cast<uint8_t>((levels[i + 1] >> 2) | (levels[i + 2] << 4)));
+		result.push_back(static_cast<uint8_t>((levels[i + 2] >> 4) | (levels[i + 3] << 2)));
+	}
+	return result;
+}
+
+
+std::vector<uint8_t> encodeImaAdpcm(const std::vector<float> &samples)
+{
+	std::vector<uint8_t> result((samples.size() + 1) / 2, 0);
+	int32_t predictor = 0;
+	int stepIndex = 0;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const int32_t sample = std::max(-32768, std::min(32767, static_cast<int>(std::lround(samples[i] * 32767.0f))));
+		const uint8_t nibble = encodeImaAdpcmSample(sample, predictor, stepIndex);
+		result[i / 2] |= ((i & 1) == 0) ? nibble : static_cast<uint8_t>(nibble << 4);
+	}
+	if ((samples.size() & 1) != 0) {
+		result.back() |= static_cast<uint8_t>(encodeImaAdpcmSample(0, predictor, stepIndex) << 4);
+	}
+	return result;
+}
+
+
+std::vector<uint8_t> encode(const std::vector<float> &samples, SDCard::Codec codec, bool dither, uint32_t seed)
+{
+	switch (codec) {
+	case SDCard::Codec_Packed6:
+		return pack(quantize(samples, codec, dither, seed));
+	case SDCard::Codec_ImaAdpcm4:
+		return encodeImaAdpcm(samples);
+	default:
+		return quantize(samples, codec, dither, seed);
+	}
+}
+
+
+}
+}
@@ -0,0 +1,62 @@
+#pragma once
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+
+
+#include "SDCard.h"
+
+#include <cinttypes>
+#include <vector>
+
+
+namespace lr {
+namespace AudioEncoder {
+
+
+/// The number of bits of the audio DAC (see SimpleIO::setAudioLevel).
+///
+const uint8_t cDacBits = 6;
+
+/// The unsigned 8bit value for silence.
+///
+const uint8_t cSilence = 0x80;
+
+
+/// Quantize the samples to the DAC resolution.
+///
+/// For Codec_Unsigned8 the result are unsigned 8bit samples where the lower bits
+/// are zero, so the shift in the player does not truncate and the rounding happens
+/// here. For all other codecs the result are the 6bit DAC values.
+///
+/// @param samples The samples in the range -1.0 to 1.0.
+/// @param codec The codec of the file.
+/// @param dither Add triangular dither with an amplitude of one step.
+/// @param seed The seed for the dither.
+///
+std::vector<uint8_t> quantize(const std::vector<float> &samples, SDCard::Codec codec, bool dither, uint32_t seed);
+
+/// Pack 6bit DAC values, four samples into three bytes (Codec_Packed6).
+///
+/// The samples are padded with silence to a multiple of four.
+///
+std::vector<uint8_t> pack(std::vector<uint8_t> levels);
+
+/// Encode the samples as 4bit IMA ADPCM (Codec_ImaAdpcm4).
+///
+/// The encoder starts with the state of ImaAdpcm::reset(). An odd number
+/// of samples is padded with silence.
+///
+/// @param samples The samples in the range -1.0 to 1.0.
+///
+std::vector<uint8_t> encodeImaAdpcm(const std::vector<float> &samples);
+
+/// Encode the samples with the given codec.
+///
+std::vector<uint8_t> encode(const std::vector<float> &samples, SDCard::Codec codec, bool dither, uint32_t seed);
+
+
+}
+}
@@ -0,0 +1,173 @@
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+// Compares the sample codecs: SD card traffic, decode time and error.
+//
+
+
+#include "AudioEncoder.h"
+
+#include "ImaAdpcm.h"
+#include "SDCard.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define LR_HAS_TSC 1
+#endif
+
+
+using namespace lr;
+
+
+namespace {
+
+
+/// The sample rate of the test signal.
+///
+const uint32_t cSampleRate = SDCard::cDefaultSampleRate;
+
+/// The length of the test signal in seconds.
+///
+const uint32_t cSignalSeconds = 10;
+
+/// The number of decode runs for the timing.
+///
+const uint32_t cDecodeRuns = 20;
+
+/// The core clock of the target, for the cycle budget of one sample.
+///
+const uint32_t cCoreClock = 48000000;
+
+/// The SPI clock for reading the SD card.
+///
+const uint32_t cSpiClock = 12000000;
+
+/// The block size of the card.
+///
+const uint32_t cBlockSize = 512;
+
+/// The bytes on the bus for each block in addition to the data (token and CRC).
+///
+const uint32_t cBlockOverhead = 3;
+
+
+/// Create a test signal with tones, a sweep and noise bursts.
+///
+std::vector<float> createTestSignal()
+{
+	std::vector<float> samples(cSampleRate * cSignalSeconds);
+	uint32_t random = 0x12345678;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const double time = static_cast<double>(i) / cSampleRate;
+		const double sweep = 200.0 + 1800.0 * std::fmod(time, 2.0) / 2.0;
+		double value = 0.4 * std::sin(2.0 * M_PI * 440.0 * time);
+		value += 0.25 * std::sin(2.0 * M_PI * sweep * time);
+		random ^= random << 13; random ^= random >> 17; random ^= random << 5;
+		const double burst = (std::fmod(time, 1.0) < 0.2) ? 0.3 : 0.0;
+		value += burst * ((random & 0xffff) / 32768.0 - 1.0);
+		samples[i] = static_cast<float>(value);
+	}
+	return samples;
+}
+
+
+/// Get the DAC values of the signal without dither, the reference for the error.
+///
+std::vector<uint8_t> referenceLevels(const std::vector<float> &samples)
+{
+	return AudioEncoder::quantize(samples, SDCard::Codec_Level6, false, 0);
+}
+
+
+/// Print the SD card traffic for a codec.
+///
+void printTraffic(const char *name, size_t encodedSize, size_t sampleCount)
+{
+	const double bytesPerSecond = static_cast<double>(encodedSize) / sampleCount * cSampleRate;
+	const double blocksPerSecond = bytesPerSecond / cBlockSize;
+	const double busBytes = bytesPerSecond + blocksPerSecond * cBlockOverhead;
+	const double busTime = busBytes * 8.0 / cSpiClock * 1000.0;
+	const double saved = 100.0 * (1.0 - static_cast<double>(encodedSize) / sampleCount);
+	std::printf("  %-10s %10.0f %10.1f %12.1f ms %9.1f%%\n", name, bytesPerSecond, blocksPerSecond, busTime, saved);
+}
+
+
+}
+
+
+int main(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+
+	const std::vector<float> samples = createTestSignal();
+	const std::vector<uint8_t> reference = referenceLevels(samples);
+
+	// The SD card traffic for one second of audio.
+	std::printf("SD card traffic for one second of audio (%u Hz):\n", cSampleRate);
+	std::printf("  %-10s %10s %10s %15s %10s\n", "Codec", "Bytes/s", "Blocks/s", "SPI time/s", "Saved");
+	const SDCard::Codec codecs[] = {SDCard::Codec_Unsigned8, SDCard::Codec_Level6, SDCard::Codec_Packed6,
+		SDCard::Codec_ImaAdpcm4};
+	const char *codecNames[] = {"u8", "level6", "packed6", "adpcm"};
+	std::vector<uint8_t> adpcm;
+	for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); ++i) {
+		const std::vector<uint8_t> encoded = AudioEncoder::encode(samples, codecs[i], true, 1);
+		printTraffic(codecNames[i], encoded.size(), samples.size());
+		if (codecs[i] == SDCard::Codec_ImaAdpcm4) {
+			adpcm = encoded;
+		}
+	}
+
+	// Decode the ADPCM stream in steps like the player and measure the time.
+	const uint16_t stepBytes = 16;
+	std::vector<uint8_t> levels(adpcm.size() * 2);
+	uint64_t totalNanoseconds = 0;
+	uint64_t totalTicks = 0;
+	for (uint32_t run = 0; run < cDecodeRuns; ++run) {
+		ImaAdpcm::State state;
+		ImaAdpcm::reset(state);
+		const auto startTime = std::chrono::steady_clock::now();
+#ifdef LR_HAS_TSC
+		const uint64_t startTicks = __rdtsc();
+#endif
+		for (size_t offset = 0; offset < adpcm.size(); offset += stepBytes) {
+			const uint16_t byteCount = static_cast<uint16_t>(std::min<size_t>(stepBytes, adpcm.size() - offset));
+			ImaAdpcm::decode(state, adpcm.data() + offset, levels.data() + offset * 2, byteCount);
+		}
+#ifdef LR_HAS_TSC
+		totalTicks += __rdtsc() - startTicks;
+#endif
+		totalNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - startTime).count();
+	}
+	const double decodedSamples = static_cast<double>(levels.size()) * cDecodeRuns;
+	std::printf("\nIMA ADPCM decode on the host (%u runs of %u s):\n", cDecodeRuns, cSignalSeconds);
+	std::printf("  %-28s %10.2f ns\n", "Time per sample:", totalNanoseconds / decodedSamples);
+	if (totalTicks > 0) {
+		std::printf("  %-28s %10.2f\n", "TSC cycles per sample:", totalTicks / decodedSamples);
+	}
+	std::printf("  %-28s %10u\n", "Target budget per sample:", cCoreClock / cSampleRate);
+
+	// The error of the decoded DAC values against the exact quantization.
+	const size_t comparedSamples = std::min(reference.size(), levels.size());
+	double squaredError = 0.0;
+	uint32_t maximumError = 0;
+	for (size_t i = 0; i < comparedSamples; ++i) {
+		const int error = static_cast<int>(levels[i]) - static_cast<int>(reference[i]);
+		squaredError += error * error;
+		maximumError = std::max<uint32_t>(maximumError, std::abs(error));
+	}
+	std::printf("\nIMA ADPCM error against the 6bit quantization:\n");
+	std::printf("  %-28s %10.3f LSB\n", "RMS error:", std::sqrt(squaredError / comparedSamples));
+	std::printf("  %-28s %10u LSB\n", "Maximum error:", maximumError);
+	return 0;
+}
@@ -0,0 +1,184 @@
+#pragma once
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+// Host replacement for the Processor Expert "Cpu.h".
+//
+// Maps all registers used by the firmware to the register-level simulation,
+// using the bit definitions of the MKE04Z4 device header.
+//
+
+
+#include "Simulation.h"
+
+#include <cinttypes>
+
+
+// Processor Expert macros
+// -----------------------
+
+#define PE_NOP() lr::Simulation::advance(lr::Simulation::cNopCycles)
+#define PE_WFI() lr::Simulation::waitForInterrupt()
+#define PE_ISR(ISR_name) void ISR_name(void)
+#define EnterCritical() lr::Simulation::enterCritical()
+#define ExitCritical() lr::Simulation::exitCritical()
+
+
+// Registers
+// ---------
+
+#define LR_SIM_REGISTER(name) (lr::Simulation::Register(lr::Simulation::Register_##name))
+
+#define SIM_SCGC LR_SIM_REGISTER(SIM_SCGC)
+#define SIM_PINSEL LR_SIM_REGISTER(SIM_PINSEL)
+#define SIM_SOPT0 LR_SIM_REGISTER(SIM_SOPT0)
+#define GPIOA_PDOR LR_SIM_REGISTER(GPIOA_PDOR)
+#define GPIOA_PSOR LR_SIM_REGISTER(GPIOA_PSOR)
+#define GPIOA_PCOR LR_SIM_REGISTER(GPIOA_PCOR)
+#define GPIOA_PTOR LR_SIM_REGISTER(GPIOA_PTOR)
+#define GPIOA_PDIR LR_SIM_REGISTER(GPIOA_PDIR)
+#define GPIOA_PDDR LR_SIM_REGISTER(GPIOA_PDDR)
+#define FTM0_SC LR_SIM_REGISTER(FTM0_SC)
+#define FTM0_CNT LR_SIM_REGISTER(FTM0_CNT)
+#define FTM0_MOD LR_SIM_REGISTER(FTM0_MOD)
+#define FTM0_C0SC LR_SIM_REGISTER(FTM0_C0SC)
+#define FTM0_C1SC LR_SIM_REGISTER(FTM0_C1SC)
+#define FTM2_SC LR_SIM_REGISTER(FTM2_SC)
+#define FTM2_CNT LR_SIM_REGISTER(FTM2_CNT)
+#define FTM2_MOD LR_SIM_REGISTER(FTM2_MOD)
+#define FTM2_CNTIN LR_SIM_REGISTER(FTM2_CNTIN)
+#define FTM2_MODE LR_SIM_REGISTER(FTM2_MODE)
+#define FTM2_C0SC LR_SIM_REGISTER(FTM2_C0SC)
+#define FTM2_C1SC LR_SIM_REGISTER(FTM2_C1SC)
+#define FTM2_C2SC LR_SIM_REGISTER(FTM2_C2SC)
+#define FTM2_C3SC LR_SIM_REGISTER(FTM2_C3SC)
+#define FTM2_C4SC LR_SIM_REGISTER(FTM2_C4SC)
+#define FTM2_C5SC LR_SIM_REGISTER(FTM2_C5SC)
+#define SPI0_C1 LR_SIM_REGISTER(SPI0_C1)
+#define SPI0_C2 LR_SIM_REGISTER(SPI0_C2)
+#define SPI0_BR LR_SIM_REGISTER(SPI0_BR)
+#define SPI0_S LR_SIM_REGISTER(SPI0_S)
+#define SPI0_D LR_SIM_REGISTER(SPI0_D)
+#define ADC_SC1 LR_SIM_REGISTER(ADC_SC1)
+#define ADC_SC2 LR_SIM_REGISTER(ADC_SC2)
+#define ADC_SC3 LR_SIM_REGISTER(ADC_SC3)
+#define ADC_SC4 LR_SIM_REGISTER(ADC_SC4)
+#define ADC_SC5 LR_SIM_REGISTER(ADC_SC5)
+#define ADC_R LR_SIM_REGISTER(ADC_R)
+#define ADC_APCTL1 LR_SIM_REGISTER(ADC_APCTL1)
+#define UART0_BDH LR_SIM_REGISTER(UART0_BDH)
+#define UART0_BDL LR_SIM_REGISTER(UART0_BDL)
+#define UART0_C1 LR_SIM_REGISTER(UART0_C1)
+#define UART0_C2 LR_SIM_REGISTER(UART0_C2)
+#define UART0_C3 LR_SIM_REGISTER(UART0_C3)
+#define UART0_S1 LR_SIM_REGISTER(UART0_S1)
+#define UART0_S2 LR_SIM_REGISTER(UART0_S2)
+#define UART0_D LR_SIM_REGISTER(UART0_D)
+
+
+// SIM
+// ---
+
+#define SIM_SCGC_FTM0_MASK 0x20u
+#define SIM_SCGC_FTM2_MASK 0x80u
+#define SIM_SCGC_SPI0_MASK 0x40000u
+#define SIM_SCGC_UART0_MASK 0x100000u
+#define SIM_SCGC_ADC_MASK 0x20000000u
+#define SIM_PINSEL_SPI0PS_MASK 0x40u
+#define SIM_SOPT0_ADHWT_MASK 0x700u
+#define SIM_SOPT0_ADHWT_SHIFT 8
+#define SIM_SOPT0_ADHWT(x) (((uint32_t)(((uint32_t)(x))<<SIM_SOPT0_ADHWT_SHIFT))&SIM_SOPT0_ADHWT_MASK)
+
+
+// FTM
+// ---
+
+#define FTM_SC_PS_MASK 0x7u
+#define FTM_SC_PS(x) (((uint32_t)(x))&FTM_SC_PS_MASK)
+#define FTM_SC_CLKS_MASK 0x18u
+#define FTM_SC_CLKS_SHIFT 3
+#define FTM_SC_CLKS(x) (((uint32_t)(((uint32_t)(x))<<FTM_SC_CLKS_SHIFT))&FTM_SC_CLKS_MASK)
+#define FTM_SC_CPWMS_MASK 0x20u
+#define FTM_SC_TOIE_MASK 0x40u
+#define FTM_SC_TOF_MASK 0x80u
+#define FTM_CNT_COUNT(x) (((uint32_t)(x))&0xFFFFu)
+#define FTM_MOD_MOD(x) (((uint32_t)(x))&0xFFFFu)
+#define FTM_CNTIN_INIT(x) (((uint32_t)(x))&0xFFFFu)
+#define FTM_MODE_WPDIS_MASK 0x4u
+#define FTM_MODE_FAULTM(x) (((uint32_t)(((uint32_t)(x))<<5))&0x60u)
+
+
+// SPI
+// ---
+
+#define SPI_C1_LSBFE_MASK 0x1u
+#define SPI_C1_SSOE_MASK 0x2u
+#define SPI_C1_CPHA_MASK 0x4u
+#define SPI_C1_CPOL_MASK 0x8u
+#define SPI_C1_MSTR_MASK 0x10u
+#define SPI_C1_SPTIE_MASK 0x20u
+#define SPI_C1_SPE_MASK 0x40u
+#define SPI_C1_SPIE_MASK 0x80u
+#define SPI_C2_SPISWAI_MASK 0x2u
+#define SPI_BR_SPR_MASK 0xFu
+#define SPI_BR_SPR(x) (((uint32_t)(x))&SPI_BR_SPR_MASK)
+#define SPI_BR_SPPR_MASK 0x70u
+#define SPI_BR_SPPR_SHIFT 4
+#define SPI_BR_SPPR(x) (((uint32_t)(((uint32_t)(x))<<SPI_BR_SPPR_SHIFT))&SPI_BR_SPPR_MASK)
+#define SPI_S_MODF_MASK 0x10u
+#define SPI_S_SPTEF_MASK 0x20u
+#define SPI_S_SPMF_MASK 0x40u
+#define SPI_S_SPRF_MASK 0x80u
+
+
+// ADC
+// ---
+
+#define ADC_SC1_ADCH_MASK 0x1Fu
+#define ADC_SC1_ADCH(x) (((uint32_t)(x))&ADC_SC1_ADCH_MASK)
+#define ADC_SC1_ADCO_MASK 0x20u
+#define ADC_SC1_AIEN_MASK 0x40u
+#define ADC_SC1_COCO_MASK 0x80u
+#define ADC_SC2_FFULL_MASK 0x4u
+#define ADC_SC2_FEMPTY_MASK 0x8u
+#define ADC_SC2_ADTRG_MASK 0x40u
+#define ADC_SC2_ADACT_MASK 0x80u
+#define ADC_SC3_ADICLK_MASK 0x3u
+#define ADC_SC3_ADICLK(x) (((uint32_t)(x))&ADC_SC3_ADICLK_MASK)
+#define ADC_SC3_MODE_MASK 0xCu
+#define ADC_SC3_MODE_SHIFT 2
+#define ADC_SC3_MODE(x) (((uint32_t)(((uint32_t)(x))<<ADC_SC3_MODE_SHIFT))&ADC_SC3_MODE_MASK)
+#define ADC_SC3_ADLSMP_MASK 0x10u
+#define ADC_SC3_ADIV_MASK 0x60u
+#define ADC_SC3_ADIV_SHIFT 5
+#define ADC_SC3_ADIV(x) (((uint32_t)(((uint32_t)(x))<<ADC_SC3_ADIV_SHIFT))&ADC_SC3_ADIV_MASK)
+#define ADC_SC3_ADLPC_MASK 0x80u
+#define ADC_SC4_AFDEP_MASK 0x7u
+#define ADC_SC4_AFDEP(x) (((uint32_t)(x))&ADC_SC4_AFDEP_MASK)
+#define ADC_SC4_ACFSEL_MASK 0x20u
+#define ADC_SC4_ASCANE_MASK 0x40u
+#define ADC_SC4_HTRGME_MASK 0x100u
+#define ADC_SC5_HTRGMASKSEL_MASK 0x1u
+#define ADC_SC5_HTRGMASKE_MASK 0x2u
+
+
+// UART
+// ----
+
+#define UART_BDH_SBR(x) (((uint32_t)(x))&0x1Fu)
+#define UART_BDL_SBR(x) (((uint32_t)(x))&0xFFu)
+#define UART_C1_UARTSWAI_MASK 0x40u
+#define UART_C2_RE_MASK 0x4u
+#define UART_C2_TE_MASK 0x8u
+#define UART_C2_ILIE_MASK 0x10u
+#define UART_C2_RIE_MASK 0x20u
+#define UART_C2_TCIE_MASK 0x40u
+#define UART_C2_TIE_MASK 0x80u
+#define UART_S1_RDRF_MASK 0x20u
+#define UART_S1_TC_MASK 0x40u
+#define UART_S1_TDRE_MASK 0x80u
+#define UART_S2_RXEDGIF_MASK 0x40u
+#define UART_S2_LBKDIF_MASK 0x80u
+
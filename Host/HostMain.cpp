@@ -0,0 +1,213 @@
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+// Runs the unchanged firmware against the register-level simulation.
+//
+
+
+#include "SDCardEmulator.h"
+#include "Simulation.h"
+
+#include "Wrapper.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+
+using namespace lr;
+
+
+namespace {
+
+
+/// The ambient light level on the sensor (12bit).
+///
+const uint16_t cAmbientLevel = 0x500;
+
+/// The reflected light of the IR LED without any object.
+///
+const uint16_t cBackgroundReflection = 24;
+
+/// The reflected light of the IR LED if there is an object in front of the sensor.
+///
+const uint16_t cObjectReflection = 240;
+
+/// The amplitude of the sensor noise.
+///
+const uint16_t cNoiseAmplitude = 4;
+
+/// The maximum number of object time ranges.
+///
+const uint8_t cMaximumObjectRanges = 8;
+
+/// A time range with an object in front of the sensor.
+///
+struct ObjectRange {
+	uint32_t startMS; ///< The start of the range.
+	uint32_t endMS; ///< The end of the range.
+};
+
+/// The time ranges with an object in front of the sensor.
+///
+ObjectRange _objectRanges[cMaximumObjectRanges];
+
+/// The number of object time ranges.
+///
+uint8_t _objectRangeCount = 0;
+
+/// The state of the pseudo random generator for the noise.
+///
+uint32_t _noiseState = 0x12345678;
+
+
+/// Get the next pseudo random value (xorshift32).
+///
+uint32_t nextRandom()
+{
+	_noiseState ^= _noiseState << 13;
+	_noiseState ^= _noiseState >> 17;
+	_noiseState ^= _noiseState << 5;
+	return _noiseState;
+}
+
+
+/// Check if an object is in front of the sensor.
+///
+bool isObjectPresent()
+{
+	const uint64_t nowMS = Simulation::cycles() / (Simulation::cCoreClock / 1000);
+	for (uint8_t i = 0; i < _objectRangeCount; ++i) {
+		if (nowMS >= _objectRanges[i].startMS && nowMS < _objectRanges[i].endMS) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/// The analog input of the light sensor.
+///
+uint16_t sensorInput(uint8_t, bool signalEnabled)
+{
+	uint16_t value = cAmbientLevel;
+	if (signalEnabled) {
+		value += isObjectPresent() ? cObjectReflection : cBackgroundReflection;
+	}
+	value += static_cast<uint16_t>(nextRandom() % (cNoiseAmplitude * 2 + 1));
+	value -= cNoiseAmplitude;
+	return value;
+}
+
+
+/// Replace "\n" escapes in an argument with newlines.
+///
+std::string unescape(const char *text)
+{
+	std::string result;
+	for (; *text != '\0'; ++text) {
+		if (text[0] == '\\' && text[1] == 'n') {
+			result += '\n';
+			++text;
+		} else {
+			result += *text;
+		}
+	}
+	return result;
+}
+
+
+/// Parse a "<ms>:<value>" argument.
+///
+bool parseTimedArgument(const char *argument, uint32_t &milliseconds, const char *&value)
+{
+	char *end;
+	milliseconds = static_cast<uint32_t>(std::strtoul(argument, &end, 10));
+	if (end == argument || *end != ':') {
+		return false;
+	}
+	value = end + 1;
+	return true;
+}
+
+
+void printUsage()
+{
+	std::fprintf(stderr,
+		"Usage: pissoff-sim [options]\n"
+		"  --time <ms>               Simulated time until the simulation ends (default 20000).\n"
+		"  --input <ms>:<text>       Send a line to the serial console at the given time.\n"
+		"  --object <ms>:<ms>        An object is in front of the sensor in the given time range.\n"
+		"  --audio-out <file>        Record the audio output as raw unsigned 8bit samples at 44.1kHz.\n"
+		"  --sd-image <file>         Insert a SD card with the given MicroDisk image.\n"
+		"  --sd-init-time <ms>       The initialization time of the SD card (default 50).\n"
+		"  --sd-token-latency <us>   The latency until a data block is ready (default 100).\n"
+		"  --sd-busy-latency <us>    The busy time after stopping a read (default 50).\n"
+		"  --sd-stall <n>:<us>       Add a stall to every n-th block of a read.\n"
+		"  --sd-read-error <n>       Answer every n-th block of a read with an error token.\n");
+}
+
+
+}
+
+
+int main(int argc, char *argv[])
+{
+	Simulation::initialize();
+	Simulation::setTimeLimit(20000);
+	Simulation::setAnalogInput(&sensorInput);
+
+	for (int i = 1; i < argc; ++i) {
+		const char *option = argv[i];
+		const char *argument = (i + 1 < argc) ? argv[i + 1] : nullptr;
+		uint32_t milliseconds;
+		const char *value;
+		if (argument == nullptr) {
+			printUsage();
+			return 1;
+		}
+		++i;
+		if (std::strcmp(option, "--time") == 0) {
+			Simulation::setTimeLimit(static_cast<uint32_t>(std::strtoul(argument, nullptr, 10)));
+		} else if (std::strcmp(option, "--input") == 0 && parseTimedArgument(argument, milliseconds, value)) {
+			Simulation::queueSerialInput(milliseconds, (unescape(value) + "\n").c_str());
+		} else if (std::strcmp(option, "--object") == 0 && parseTimedArgument(argument, milliseconds, value)
+			&& _objectRangeCount < cMaximumObjectRanges) {
+			_objectRanges[_objectRangeCount].startMS = milliseconds;
+			_objectRanges[_objectRangeCount].endMS = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			++_objectRangeCount;
+		} else if (std::strcmp(option, "--audio-out") == 0) {
+			if (!Simulation::setAudioOutput(argument)) {
+				std::fprintf(stderr, "Could not create audio output file: %s\n", argument);
+				return 1;
+			}
+		} else if (std::strcmp(option, "--sd-image") == 0) {
+			if (!SDCardEmulator::initialize(argument)) {
+				std::fprintf(stderr, "Could not read the SD card image: %s\n", argument);
+				return 1;
+			}
+		} else if (std::strcmp(option, "--sd-init-time") == 0) {
+			SDCardEmulator::setInitializationTime(static_cast<uint32_t>(std::strtoul(argument, nullptr, 10)));
+		} else if (std::strcmp(option, "--sd-token-latency") == 0) {
+			SDCardEmulator::setTokenLatency(static_cast<uint32_t>(std::strtoul(argument, nullptr, 10)));
+		} else if (std::strcmp(option, "--sd-busy-latency") == 0) {
+			SDCardEmulator::setBusyLatency(static_cast<uint32_t>(std::strtoul(argument, nullptr, 10)));
+		} else if (std::strcmp(option, "--sd-stall") == 0 && parseTimedArgument(argument, milliseconds, value)) {
+			SDCardEmulator::setStall(milliseconds, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+		} else if (std::strcmp(option, "--sd-read-error") == 0) {
+			SDCardEmulator::setReadErrors(static_cast<uint32_t>(std::strtoul(argument, nullptr, 10)));
+		} else {
+			printUsage();
+			return 1;
+		}
+	}
+
+	// Run the firmware until the time limit is reached.
+	lrMain();
+	Simulation::finish();
+	return 0;
+}
+
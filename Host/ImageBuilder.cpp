@@ -0,0 +1,611 @@
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+// Builds a MicroDisk SD card image from a folder with WAV files.
+//
+
+
+#include "AudioEncoder.h"
+#include "SDCard.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using namespace lr;
+
+
+namespace {
+
+
+/// The block size of the card.
+///
+const uint32_t cBlockSize = 512;
+
+/// The size of a version 2 directory record.
+///
+const uint16_t cRecordSize = 40;
+
+/// The size of the name field in a version 2 record.
+///
+const uint8_t cRecordNameSize = 16;
+
+/// The size of the sound bank header.
+///
+const uint32_t cSoundBankHeaderSize = 8;
+
+/// The size of a record in the segment table of a sound bank.
+///
+const uint32_t cSegmentRecordSize = 8;
+
+/// The maximum number of segments in a sound bank, the firmware uses 8bit indexes.
+///
+const size_t cMaximumSegmentCount = 256;
+
+
+/// A sound file and its encoded samples.
+///
+struct SoundFile {
+	std::string path; ///< The path of the source file or folder.
+	std::string name; ///< The name in the directory (file name without extension).
+	std::vector<std::string> segmentPaths; ///< The source files of the segments, empty if this is no sound bank.
+	std::vector<uint8_t> data; ///< The encoded samples.
+	std::string error; ///< The error message if the file could not be encoded.
+	uint32_t startBlock; ///< The first block of the file in the image.
+};
+
+
+/// The decoded samples of a WAV file.
+///
+struct PcmData {
+	uint32_t sampleRate; ///< The sample rate in Hz.
+	std::vector<float> samples; ///< Mono samples in the range -1.0 to 1.0.
+};
+
+
+/// The options of the tool.
+///
+struct Options {
+	uint32_t sampleRate = SDCard::cDefaultSampleRate; ///< The sample rate of the player.
+	bool dither = true; ///< Add triangular dither before the quantization.
+	bool version1 = false; ///< Write a version 1 ("HCDI") directory.
+	SDCard::Codec codec = SDCard::Codec_Level6; ///< The codec for the samples.
+	unsigned jobs = 0; ///< The number of worker threads, 0 = one per core.
+};
+
+
+/// Calculate the hash for a file name, the same as SDCard::nameHash().
+///
+uint32_t nameHash(const std::string &name)
+{
+	uint32_t hash = 0x811c9dc5U;
+	for (const char c : name) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 0x01000193U;
+	}
+	return hash;
+}
+
+
+uint16_t readUInt16(const uint8_t *value)
+{
+	return static_cast<uint16_t>(value[0] | (value[1] << 8));
+}
+
+
+uint32_t readUInt32(const uint8_t *value)
+{
+	return static_cast<uint32_t>(value[0]) | (static_cast<uint32_t>(value[1]) << 8) |
+		(static_cast<uint32_t>(value[2]) << 16) | (static_cast<uint32_t>(value[3]) << 24);
+}
+
+
+void appendUInt16(std::vector<uint8_t> &buffer, uint16_t value)
+{
+	buffer.push_back(static_cast<uint8_t>(value));
+	buffer.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+
+void appendUInt32(std::vector<uint8_t> &buffer, uint32_t value)
+{
+	for (uint8_t i = 0; i < 4; ++i) {
+		buffer.push_back(static_cast<uint8_t>(value >> (i * 8)));
+	}
+}
+
+
+/// Read a whole file into memory.
+///
+bool readFile(const std::string &path, std::vector<uint8_t> &content)
+{
+	FILE *file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		return false;
+	}
+	uint8_t buffer[4096];
+	size_t count;
+	while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		content.insert(content.end(), buffer, buffer + count);
+	}
+	std::fclose(file);
+	return true;
+}
+
+
+/// Decode a WAV file with 8/16/24/32bit integer or 32bit float samples and mix it to mono.
+///
+bool decodeWav(const std::vector<uint8_t> &content, PcmData &pcm, std::string &error)
+{
+	if (content.size() < 12 || std::memcmp(content.data(), "RIFF", 4) != 0 ||
+		std::memcmp(content.data() + 8, "WAVE", 4) != 0) {
+		error = "not a WAV file";
+		return false;
+	}
+	uint16_t format = 0;
+	uint16_t channels = 0;
+	uint16_t bitsPerSample = 0;
+	const uint8_t *data = nullptr;
+	size_t dataSize = 0;
+	size_t offset = 12;
+	while (offset + 8 <= content.size()) {
+		const uint8_t *chunk = content.data() + offset;
+		const size_t chunkSize = std::min<size_t>(readUInt32(chunk + 4), content.size() - offset - 8);
+		if (std::memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16) {
+			format = readUInt16(chunk + 8);
+			channels = readUInt16(chunk + 10);
+			pcm.sampleRate = readUInt32(chunk + 12);
+			bitsPerSample = readUInt16(chunk + 22);
+			if (format == 0xfffe && chunkSize >= 26) {
+				format = readUInt16(chunk + 32); // WAVE_FORMAT_EXTENSIBLE, the sub format.
+			}
+		} else if (std::memcmp(chunk, "data", 4) == 0) {
+			data = chunk + 8;
+			dataSize = chunkSize;
+		}
+		offset += 8 + chunkSize + (chunkSize & 1);
+	}
+	const bool isInteger = (format == 1 && (bitsPerSample == 8 || bitsPerSample == 16 ||
+		bitsPerSample == 24 || bitsPerSample == 32));
+	const bool isFloat = (format == 3 && bitsPerSample == 32);
+	if (!isInteger && !isFloat) {
+		error = "unsupported sample format";
+		return false;
+	}
+	if (channels == 0 || pcm.sampleRate == 0 || data == nullptr) {
+		error = "missing format or data chunk";
+		return false;
+	}
+	const size_t bytesPerSample = bitsPerSample / 8;
+	const size_t frameCount = dataSize / (bytesPerSample * channels);
+	pcm.samples.resize(frameCount);
+	for (size_t frame = 0; frame < frameCount; ++frame) {
+		float sum = 0.0f;
+		for (uint16_t channel = 0; channel < channels; ++channel) {
+			const uint8_t *sample = data + (frame * channels + channel) * bytesPerSample;
+			float value;
+			if (isFloat) {
+				std::memcpy(&value, sample, sizeof(value));
+			} else if (bitsPerSample == 8) {
+				value = (static_cast<int>(sample[0]) - 128) / 128.0f;
+			} else {
+				int32_t integer = 0;
+				for (size_t i = 0; i < bytesPerSample; ++i) {
+					integer |= static_cast<int32_t>(sample[i]) << (32 - bitsPerSample + i * 8);
+				}
+				value = integer / 2147483648.0f;
+			}
+			sum += value;
+		}
+		pcm.samples[frame] = sum / channels;
+	}
+	return true;
+}
+
+
+/// Resample the samples to the given rate using linear interpolation.
+///
+/// If the rate is reduced, a simple moving average over the source samples
+/// of one target period limits the aliasing.
+///
+std::vector<float> resample(const PcmData &pcm, uint32_t sampleRate)
+{
+	if (pcm.sampleRate == sampleRate || pcm.samples.empty()) {
+		return pcm.samples;
+	}
+	std::vector<float> source = pcm.samples;
+	const double ratio = static_cast<double>(pcm.sampleRate) / sampleRate;
+	if (ratio > 1.0) {
+		const size_t window = static_cast<size_t>(std::ceil(ratio));
+		std::vector<float> filtered(source.size());
+		double sum = 0.0;
+		for (size_t i = 0; i < source.size(); ++i) {
+			sum += source[i];
+			if (i >= window) {
+				sum -= source[i - window];
+			}
+			filtered[i] = static_cast<float>(sum / std::min(i + 1, window));
+		}
+		source.swap(filtered);
+	}
+	const size_t targetCount = static_cast<size_t>(source.size() / ratio);
+	std::vector<float> result(targetCount);
+	for (size_t i = 0; i < targetCount; ++i) {
+		const double position = i * ratio;
+		const size_t index = static_cast<size_t>(position);
+		const double fraction = position - index;
+		const float next = (index + 1 < source.size()) ? source[index + 1] : source[index];
+		result[i] = static_cast<float>(source[index] * (1.0 - fraction) + next * fraction);
+	}
+	return result;
+}
+
+
+/// Decode, resample and encode one WAV file.
+///
+bool encodeSamples(const std::string &path, const Options &options, uint32_t seed,
+	std::vector<uint8_t> &data, std::string &error)
+{
+	std::vector<uint8_t> content;
+	if (!readFile(path, content)) {
+		error = "could not read the file";
+		return false;
+	}
+	PcmData pcm;
+	if (!decodeWav(content, pcm, error)) {
+		return false;
+	}
+	data = AudioEncoder::encode(resample(pcm, options.sampleRate), options.codec, options.dither, seed);
+	return true;
+}
+
+
+/// Encode the segments of a sound bank and write them after the segment table.
+///
+/// Each segment is encoded on its own, so it can be played from its start.
+/// The segments follow each other without padding.
+///
+void encodeSoundBank(SoundFile &file, const Options &options)
+{
+	std::vector<std::vector<uint8_t>> segments(file.segmentPaths.size());
+	for (size_t i = 0; i < segments.size(); ++i) {
+		if (!encodeSamples(file.segmentPaths[i], options, nameHash(file.name) + static_cast<uint32_t>(i),
+			segments[i], file.error)) {
+			file.error = file.segmentPaths[i] + ": " + file.error;
+			return;
+		}
+	}
+	file.data.insert(file.data.end(), {'H', 'C', 'S', 'B'});
+	appendUInt16(file.data, static_cast<uint16_t>(segments.size()));
+	appendUInt16(file.data, 0); // Reserved.
+	uint32_t offset = cSoundBankHeaderSize + static_cast<uint32_t>(segments.size()) * cSegmentRecordSize;
+	for (const std::vector<uint8_t> &segment : segments) {
+		appendUInt32(file.data, offset);
+		appendUInt32(file.data, static_cast<uint32_t>(segment.size()));
+		offset += static_cast<uint32_t>(segment.size());
+	}
+	for (const std::vector<uint8_t> &segment : segments) {
+		file.data.insert(file.data.end(), segment.begin(), segment.end());
+	}
+}
+
+
+/// Decode, resample and encode one file or sound bank.
+///
+void encodeFile(SoundFile &file, const Options &options)
+{
+	if (!file.segmentPaths.empty()) {
+		encodeSoundBank(file, options);
+	} else {
+		encodeSamples(file.path, options, nameHash(file.name), file.data, file.error);
+	}
+}
+
+
+/// Encode all files using a pool of worker threads.
+///
+void encodeFiles(std::vector<SoundFile> &files, const Options &options)
+{
+	unsigned jobs = options.jobs;
+	if (jobs == 0) {
+		jobs = std::max(1u, std::thread::hardware_concurrency());
+	}
+	jobs = std::min<unsigned>(jobs, static_cast<unsigned>(files.size()));
+	std::atomic<size_t> nextFile(0);
+	auto worker = [&]() {
+		size_t index;
+		while ((index = nextFile++) < files.size()) {
+			encodeFile(files[index], options);
+		}
+	};
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < jobs; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+}
+
+
+/// Find all WAV files in a folder, sorted by name.
+///
+/// Each sub folder with WAV files is added as a sound bank, the files in the
+/// sub folder are the segments, sorted by name. Deeper folders are ignored.
+///
+bool findFiles(const std::string &folder, std::vector<SoundFile> &files)
+{
+	DIR *directory = opendir(folder.c_str());
+	if (directory == nullptr) {
+		return false;
+	}
+	while (const dirent *entry = readdir(directory)) {
+		const std::string fileName = entry->d_name;
+		struct stat status;
+		if (fileName[0] != '.' && stat((folder + "/" + fileName).c_str(), &status) == 0 && S_ISDIR(status.st_mode)) {
+			std::vector<SoundFile> segments;
+			if (!findFiles(folder + "/" + fileName, segments)) {
+				closedir(directory);
+				return false;
+			}
+			SoundFile bank;
+			bank.path = folder + "/" + fileName;
+			bank.name = fileName;
+			bank.startBlock = 0;
+			for (const SoundFile &segment : segments) {
+				if (segment.segmentPaths.empty()) {
+					bank.segmentPaths.push_back(segment.path);
+				}
+			}
+			if (!bank.segmentPaths.empty()) {
+				files.push_back(bank);
+			}
+			continue;
+		}
+		const size_t dot = fileName.rfind('.');
+		if (dot == std::string::npos || dot == 0) {
+			continue;
+		}
+		std::string extension = fileName.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension != "wav") {
+			continue;
+		}
+		SoundFile file;
+		file.path = folder + "/" + fileName;
+		file.name = fileName.substr(0, dot);
+		file.startBlock = 0;
+		files.push_back(file);
+	}
+	closedir(directory);
+	std::sort(files.begin(), files.end(), [](const SoundFile &a, const SoundFile &b) {
+		return a.name < b.name;
+	});
+	return true;
+}
+
+
+/// Check the limits of the directory in the firmware.
+///
+bool checkLimits(const std::vector<SoundFile> &files, const Options &options)
+{
+	if (files.size() > SDCard::cMaximumFileCount) {
+		std::fprintf(stderr, "Too many files: %zu, the firmware supports %u.\n",
+			files.size(), SDCard::cMaximumFileCount);
+		return false;
+	}
+	size_t namePoolSize = 0;
+	for (const SoundFile &file : files) {
+		if (!options.version1 && file.name.size() > cRecordNameSize) {
+			std::fprintf(stderr, "The name \"%s\" is longer than %u characters.\n",
+				file.name.c_str(), cRecordNameSize);
+			return false;
+		}
+		if (file.name.size() > 255) {
+			std::fprintf(stderr, "The name \"%s\" is too long.\n", file.name.c_str());
+			return false;
+		}
+		if (!file.segmentPaths.empty() && options.version1) {
+			std::fprintf(stderr, "A version 1 directory can not contain the sound bank \"%s\".\n",
+				file.name.c_str());
+			return false;
+		}
+		if (file.segmentPaths.size() > cMaximumSegmentCount) {
+			std::fprintf(stderr, "The sound bank \"%s\" has %zu segments, the firmware supports %zu.\n",
+				file.name.c_str(), file.segmentPaths.size(), cMaximumSegmentCount);
+			return false;
+		}
+		namePoolSize += file.name.size() + 1;
+	}
+	if (namePoolSize > SDCard::cNamePoolSize) {
+		std::fprintf(stderr, "The names need %zu bytes, the firmware supports %u.\n",
+			namePoolSize, SDCard::cNamePoolSize);
+		return false;
+	}
+	if (options.version1 && options.sampleRate != SDCard::cDefaultSampleRate) {
+		std::fprintf(stderr, "A version 1 directory can only contain files with %u Hz.\n",
+			SDCard::cDefaultSampleRate);
+		return false;
+	}
+	return true;
+}
+
+
+/// Create the directory block.
+///
+std::vector<uint8_t> createDirectory(const std::vector<SoundFile> &files, const Options &options)
+{
+	std::vector<uint8_t> directory;
+	if (options.version1) {
+		directory.insert(directory.end(), {'H', 'C', 'D', 'I'});
+		for (const SoundFile &file : files) {
+			appendUInt32(directory, file.startBlock);
+			appendUInt32(directory, static_cast<uint32_t>(file.data.size()));
+			directory.push_back(static_cast<uint8_t>(file.name.size()));
+			directory.insert(directory.end(), file.name.begin(), file.name.end());
+		}
+		appendUInt32(directory, 0);
+		appendUInt32(directory, 0);
+		directory.push_back(0);
+	} else {
+		std::vector<const SoundFile*> sortedFiles;
+		for (const SoundFile &file : files) {
+			sortedFiles.push_back(&file);
+		}
+		std::stable_sort(sortedFiles.begin(), sortedFiles.end(), [](const SoundFile *a, const SoundFile *b) {
+			return nameHash(a->name) < nameHash(b->name);
+		});
+		directory.insert(directory.end(), {'H', 'C', 'D', '2'});
+		appendUInt16(directory, static_cast<uint16_t>(files.size()));
+		appendUInt16(directory, cRecordSize);
+		for (const SoundFile *file : sortedFiles) {
+			appendUInt32(directory, nameHash(file->name));
+			appendUInt32(directory, file->startBlock);
+			appendUInt32(directory, static_cast<uint32_t>(file->data.size()));
+			appendUInt16(directory, static_cast<uint16_t>(options.sampleRate));
+			directory.push_back(options.codec);
+			directory.push_back(file->segmentPaths.empty() ? SDCard::FileType_Sound : SDCard::FileType_SoundBank);
+			appendUInt32(directory, 0); // Loop start.
+			appendUInt32(directory, 0); // Loop end.
+			std::string name = file->name;
+			name.resize(cRecordNameSize, '\0');
+			directory.insert(directory.end(), name.begin(), name.end());
+		}
+	}
+	return directory;
+}
+
+
+void printUsage()
+{
+	std::fprintf(stderr,
+		"Usage: pissoff-image [options] <folder> <image>\n"
+		"  Creates a MicroDisk SD card image with all WAV files from the folder.\n"
+		"  Each sub folder is added as a sound bank with its WAV files as segments.\n"
+		"  --rate <hz>       The sample rate of the player (default 44100).\n"
+		"  --jobs <n>        The number of parallel encoders (default: number of cores).\n"
+		"  --no-dither       Quantize without dither.\n"
+		"  --codec <codec>   The codec for the samples: level6 (default), packed6, adpcm or u8.\n"
+		"  --v1              Write a version 1 (\"HCDI\") directory, implies --codec u8.\n");
+}
+
+
+}
+
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	std::vector<std::string> arguments;
+	for (int i = 1; i < argc; ++i) {
+		const char *option = argv[i];
+		if (std::strcmp(option, "--rate") == 0 && i + 1 < argc) {
+			options.sampleRate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		} else if (std::strcmp(option, "--jobs") == 0 && i + 1 < argc) {
+			options.jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		} else if (std::strcmp(option, "--no-dither") == 0) {
+			options.dither = false;
+		} else if (std::strcmp(option, "--codec") == 0 && i + 1 < argc) {
+			const char *codec = argv[++i];
+			if (std::strcmp(codec, "level6") == 0) {
+				options.codec = SDCard::Codec_Level6;
+			} else if (std::strcmp(codec, "packed6") == 0) {
+				options.codec = SDCard::Codec_Packed6;
+			} else if (std::strcmp(codec, "adpcm") == 0) {
+				options.codec = SDCard::Codec_ImaAdpcm4;
+			} else if (std::strcmp(codec, "u8") == 0) {
+				options.codec = SDCard::Codec_Unsigned8;
+			} else {
+				printUsage();
+				return 1;
+			}
+		} else if (std::strcmp(option, "--v1") == 0) {
+			options.version1 = true;
+		} else if (option[0] == '-') {
+			printUsage();
+			return 1;
+		} else {
+			arguments.push_back(option);
+		}
+	}
+	if (arguments.size() != 2 || options.sampleRate == 0 || options.sampleRate > 0xffff) {
+		printUsage();
+		return 1;
+	}
+	if (options.version1) {
+		options.codec = SDCard::Codec_Unsigned8;
+	}
+
+	// Collect and check the files.
+	std::vector<SoundFile> files;
+	if (!findFiles(arguments[0], files)) {
+		std::fprintf(stderr, "Could not read the folder: %s\n", arguments[0].c_str());
+		return 1;
+	}
+	if (!checkLimits(files, options)) {
+		return 1;
+	}
+
+	// Encode all files in parallel.
+	encodeFiles(files, options);
+	bool success = true;
+	for (const SoundFile &file : files) {
+		if (!file.error.empty()) {
+			std::fprintf(stderr, "%s: %s\n", file.path.c_str(), file.error.c_str());
+			success = false;
+		}
+	}
+	if (!success) {
+		return 1;
+	}
+
+	// Assign the blocks, the directory uses block 0.
+	uint32_t block = 1;
+	for (SoundFile &file : files) {
+		file.startBlock = block;
+		block += static_cast<uint32_t>((file.data.size() + cBlockSize - 1) / cBlockSize);
+	}
+	std::vector<uint8_t> directory = createDirectory(files, options);
+	if (directory.size() > cBlockSize) {
+		std::fprintf(stderr, "The directory does not fit into one block.\n");
+		return 1;
+	}
+	directory.resize(cBlockSize, 0);
+
+	// Write the image.
+	FILE *image = std::fopen(arguments[1].c_str(), "wb");
+	if (image == nullptr) {
+		std::fprintf(stderr, "Could not create the image: %s\n", arguments[1].c_str());
+		return 1;
+	}
+	bool written = (std::fwrite(directory.data(), 1, directory.size(), image) == directory.size());
+	for (SoundFile &file : files) {
+		std::printf("%-16s block %6u  %8zu bytes", file.name.c_str(), file.startBlock, file.data.size());
+		if (!file.segmentPaths.empty()) {
+			std::printf("  %zu segments", file.segmentPaths.size());
+		}
+		std::printf("\n");
+		file.data.resize(((file.data.size() + cBlockSize - 1) / cBlockSize) * cBlockSize, AudioEncoder::cSilence);
+		written = written && (std::fwrite(file.data.data(), 1, file.data.size(), image) == file.data.size());
+	}
+	written = (std::fclose(image) == 0) && written;
+	if (!written) {
+		std::fprintf(stderr, "Could not write the image: %s\n", arguments[1].c_str());
+		return 1;
+	}
+	std::printf("%u blocks written.\n", block);
+	return 0;
+}
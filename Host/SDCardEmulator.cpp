@@ -0,0 +1,449 @@
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+#include "SDCardEmulator.h"
+
+
+#include "Simulation.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+namespace lr {
+namespace SDCardEmulator {
+
+
+// Constants
+// ---------
+
+/// The block size.
+///
+const uint16_t cBlockSize = 512;
+
+/// The OCR register: Powered up, SDHC, 2.7-3.6V.
+///
+const uint32_t cOperationConditions = 0xc0ff8000U;
+
+/// R1 flags.
+///
+const uint8_t cR1Ready = 0x00;
+const uint8_t cR1IdleState = 0x01;
+const uint8_t cR1IllegalCommand = 0x04;
+const uint8_t cR1ParameterError = 0x40;
+
+/// Data tokens.
+///
+const uint8_t cBlockDataStart = 0xfe;
+const uint8_t cErrorTokenCardEccFailed = 0x04;
+const uint8_t cErrorTokenOutOfRange = 0x08;
+
+/// The cycles per microsecond.
+///
+const uint32_t cCyclesPerMicrosecond = Simulation::cCoreClock / 1000000;
+
+
+/// The state of the card.
+///
+enum State : uint8_t {
+	State_Inactive, ///< Not in SPI mode (before CMD0).
+	State_Idle, ///< Waiting for commands.
+	State_WaitToken, ///< Waiting until the next data block is ready.
+	State_SendBlock, ///< Sending the data token, the data and the CRC.
+};
+
+
+// Component Variables
+// -------------------
+
+/// The card image, a multiple of the block size.
+///
+std::vector<uint8_t> _image;
+
+/// The number of blocks in the image.
+///
+uint32_t _blockCount = 0;
+
+/// The state of the card.
+///
+State _state = State_Inactive;
+
+/// If the card is selected.
+///
+bool _selected = false;
+
+/// If the card finished the initialization (ACMD41).
+///
+bool _initialized = false;
+
+/// If the last command was CMD55.
+///
+bool _applicationCommand = false;
+
+/// The cycle of the first ACMD41.
+///
+uint64_t _initializationStartCycle = 0;
+
+/// The received command bytes.
+///
+uint8_t _command[6];
+uint8_t _commandLength = 0;
+
+/// The queued response bytes.
+///
+uint8_t _response[8];
+uint8_t _responseLength = 0;
+uint8_t _responseIndex = 0;
+
+/// The cycle until the card signals busy.
+///
+uint64_t _busyUntilCycle = 0;
+
+/// The current block of a read.
+///
+uint32_t _block = 0;
+
+/// If the current read is a multiple block read.
+///
+bool _multipleBlocks = false;
+
+/// The index of the next byte in the block (token = 0, data, CRC).
+///
+uint16_t _blockByteIndex = 0;
+
+/// The cycle when the next data token is ready.
+///
+uint64_t _tokenCycle = 0;
+
+/// The cycle of the first poll for the current data token, 0 if not polled yet.
+///
+uint64_t _firstPollCycle = 0;
+
+/// The cycle when the data token of the current block was sent.
+///
+uint64_t _blockStartCycle = 0;
+
+/// Settings.
+///
+uint32_t _initializationTime = 50;
+uint32_t _tokenLatency = 100;
+uint32_t _busyLatency = 50;
+uint32_t _stallInterval = 0;
+uint32_t _stallLatency = 0;
+uint32_t _readErrorInterval = 0;
+
+/// Statistics.
+///
+uint32_t _commandCount = 0;
+uint32_t _blocksRead = 0;
+uint32_t _readCommands = 0;
+uint32_t _tokenCount = 0;
+uint32_t _readErrors = 0;
+uint64_t _totalBlockCycles = 0;
+uint64_t _maximumBlockCycles = 0;
+uint64_t _totalTokenWaitCycles = 0;
+uint64_t _maximumTokenWaitCycles = 0;
+
+
+// Internal Functions
+// ------------------
+
+/// Queue a response, starting with one fill byte (Ncr).
+///
+void queueResponse(const uint8_t *bytes, uint8_t length)
+{
+	_response[0] = 0xff;
+	std::memcpy(_response + 1, bytes, length);
+	_responseLength = length + 1;
+	_responseIndex = 0;
+}
+
+
+/// Queue a R1 response.
+///
+void queueR1(uint8_t r1)
+{
+	queueResponse(&r1, 1);
+}
+
+
+/// Queue a response with a 32bit value (R3/R7).
+///
+void queueR1WithValue(uint8_t r1, uint32_t value)
+{
+	const uint8_t bytes[5] = {r1, static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+		static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)};
+	queueResponse(bytes, 5);
+}
+
+
+/// Schedule the next data token.
+///
+void scheduleToken()
+{
+	uint64_t latency = static_cast<uint64_t>(_tokenLatency) * cCyclesPerMicrosecond;
+	if (_stallInterval > 0 && _blocksRead > 0 && (_blocksRead % _stallInterval) == 0) {
+		latency += static_cast<uint64_t>(_stallLatency) * cCyclesPerMicrosecond;
+	}
+	_state = State_WaitToken;
+	_tokenCycle = Simulation::cycles() + latency;
+	_firstPollCycle = 0;
+}
+
+
+void processCommand()
+{
+	const uint8_t index = _command[0] & 0x3f;
+	const uint32_t argument = (static_cast<uint32_t>(_command[1]) << 24) | (static_cast<uint32_t>(_command[2]) << 16) |
+		(static_cast<uint32_t>(_command[3]) << 8) | static_cast<uint32_t>(_command[4]);
+	const bool applicationCommand = _applicationCommand;
+	_applicationCommand = false;
+	++_commandCount;
+	if (_state == State_Inactive && index != 0) {
+		return; // Only CMD0 switches the card into SPI mode.
+	}
+	// Any command stops a running read.
+	_state = State_Idle;
+	const uint8_t r1 = _initialized ? cR1Ready : cR1IdleState;
+	switch (index) {
+	case 0:
+		_initialized = false;
+		_initializationStartCycle = 0;
+		queueR1(cR1IdleState);
+		break;
+	case 8:
+		queueR1WithValue(r1, 0x00000100U | (argument & 0xff));
+		break;
+	case 12:
+		queueR1(r1);
+		_busyUntilCycle = Simulation::cycles() + static_cast<uint64_t>(_busyLatency) * cCyclesPerMicrosecond;
+		break;
+	case 16:
+		queueR1((argument == cBlockSize) ? r1 : (r1 | cR1ParameterError));
+		break;
+	case 17:
+	case 18:
+		if (!_initialized || argument >= _blockCount) {
+			queueR1(r1 | cR1ParameterError);
+			break;
+		}
+		queueR1(cR1Ready);
+		_block = argument;
+		_multipleBlocks = (index == 18);
+		++_readCommands;
+		scheduleToken();
+		break;
+	case 41:
+		if (!applicationCommand) {
+			queueR1(r1 | cR1IllegalCommand);
+			break;
+		}
+		if (_initializationStartCycle == 0) {
+			_initializationStartCycle = Simulation::cycles();
+		}
+		if (Simulation::cycles() - _initializationStartCycle >=
+			static_cast<uint64_t>(_initializationTime) * (Simulation::cCoreClock / 1000)) {
+			_initialized = true;
+		}
+		queueR1(_initialized ? cR1Ready : cR1IdleState);
+		break;
+	case 55:
+		_applicationCommand = true;
+		queueR1(r1);
+		break;
+	case 58:
+		queueR1WithValue(r1, cOperationConditions);
+		break;
+	default:
+		queueR1(r1 | cR1IllegalCommand);
+		break;
+	}
+}
+
+
+/// Get the next byte the card sends.
+///
+uint8_t nextOutput()
+{
+	if (_responseIndex < _responseLength) {
+		return _response[_responseIndex++];
+	}
+	if (Simulation::cycles() < _busyUntilCycle) {
+		return 0x00;
+	}
+	uint8_t result = 0xff;
+	switch (_state) {
+	case State_WaitToken:
+		if (_firstPollCycle == 0) {
+			_firstPollCycle = Simulation::cycles();
+		}
+		if (Simulation::cycles() >= _tokenCycle) {
+			const uint64_t waitCycles = Simulation::cycles() - _firstPollCycle;
+			_totalTokenWaitCycles += waitCycles;
+			_maximumTokenWaitCycles = std::max(_maximumTokenWaitCycles, waitCycles);
+			++_tokenCount;
+			if (_readErrorInterval > 0 && (_tokenCount % _readErrorInterval) == 0) {
+				// The card aborts the read, the controller has to send a new command.
+				++_readErrors;
+				_state = State_Idle;
+				result = cErrorTokenCardEccFailed;
+			} else if (_block >= _blockCount) {
+				_state = State_Idle;
+				result = cErrorTokenOutOfRange;
+			} else {
+				_state = State_SendBlock;
+				_blockByteIndex = 1;
+				_blockStartCycle = Simulation::cycles();
+				result = cBlockDataStart;
+			}
+		}
+		break;
+	case State_SendBlock:
+		if (_blockByteIndex <= cBlockSize) {
+			result = _image[static_cast<size_t>(_block) * cBlockSize + _blockByteIndex - 1];
+		}
+		// The two CRC bytes are not checked by the firmware and are sent as 0xff.
+		if (++_blockByteIndex == cBlockSize + 3) {
+			const uint64_t blockCycles = Simulation::cycles() - _blockStartCycle;
+			_totalBlockCycles += blockCycles;
+			_maximumBlockCycles = std::max(_maximumBlockCycles, blockCycles);
+			++_block;
+			++_blocksRead;
+			if (_multipleBlocks) {
+				scheduleToken();
+			} else {
+				_state = State_Idle;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	return result;
+}
+
+
+/// Receive a byte from the controller.
+///
+void receive(uint8_t mosi)
+{
+	if (_commandLength == 0 && (mosi & 0xc0) != 0x40) {
+		return; // Not the start of a command.
+	}
+	_command[_commandLength++] = mosi;
+	if (_commandLength == sizeof(_command)) {
+		_commandLength = 0;
+		processCommand();
+	}
+}
+
+
+uint8_t exchange(uint8_t mosi)
+{
+	if (!_selected) {
+		return 0xff;
+	}
+	const uint8_t miso = nextOutput();
+	receive(mosi);
+	return miso;
+}
+
+
+void chipSelect(bool selected)
+{
+	_selected = selected;
+}
+
+
+/// Print the statistics of the card.
+///
+void printReport()
+{
+	std::fprintf(stderr, "SD card emulator:\n");
+	std::fprintf(stderr, "  %-22s %12u\n", "Commands:", _commandCount);
+	std::fprintf(stderr, "  %-22s %12u\n", "Read commands:", _readCommands);
+	std::fprintf(stderr, "  %-22s %12u\n", "Blocks read:", _blocksRead);
+	if (_readErrorInterval > 0) {
+		std::fprintf(stderr, "  %-22s %12u\n", "Read errors:", _readErrors);
+	}
+	if (_tokenCount > 0) {
+		std::fprintf(stderr, "  %-22s %12u us\n", "Avg token wait:",
+			Simulation::cyclesToMicroseconds(_totalTokenWaitCycles / _tokenCount));
+		std::fprintf(stderr, "  %-22s %12u us\n", "Max token wait:",
+			Simulation::cyclesToMicroseconds(_maximumTokenWaitCycles));
+	}
+	if (_blocksRead > 0) {
+		std::fprintf(stderr, "  %-22s %12u us\n", "Avg block transfer:",
+			Simulation::cyclesToMicroseconds(_totalBlockCycles / _blocksRead));
+		std::fprintf(stderr, "  %-22s %12u us\n", "Max block transfer:",
+			Simulation::cyclesToMicroseconds(_maximumBlockCycles));
+	}
+}
+
+
+// Interface Functions
+// -------------------
+
+bool initialize(const char *path)
+{
+	FILE *file = std::fopen(path, "rb");
+	if (file == nullptr) {
+		return false;
+	}
+	_image.clear();
+	uint8_t buffer[cBlockSize];
+	size_t count;
+	while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		_image.insert(_image.end(), buffer, buffer + count);
+	}
+	std::fclose(file);
+	_image.resize(((_image.size() + cBlockSize - 1) / cBlockSize) * cBlockSize, 0);
+	_blockCount = static_cast<uint32_t>(_image.size() / cBlockSize);
+	if (_blockCount == 0 || (std::memcmp(_image.data(), "HCDI", 4) != 0 && std::memcmp(_image.data(), "HCD2", 4) != 0)) {
+		std::fprintf(stderr, "Warning: %s is not a MicroDisk image.\n", path);
+	}
+	_state = State_Inactive;
+	Simulation::setSpiDevice(&exchange, &chipSelect);
+	Simulation::addReport(&printReport);
+	return true;
+}
+
+
+void setInitializationTime(uint32_t milliseconds)
+{
+	_initializationTime = milliseconds;
+}
+
+
+void setTokenLatency(uint32_t microseconds)
+{
+	_tokenLatency = microseconds;
+}
+
+
+void setBusyLatency(uint32_t microseconds)
+{
+	_busyLatency = microseconds;
+}
+
+
+void setStall(uint32_t interval, uint32_t microseconds)
+{
+	_stallInterval = interval;
+	_stallLatency = microseconds;
+}
+
+
+void setReadErrors(uint32_t interval)
+{
+	_readErrorInterval = interval;
+}
+
+
+}
+}
+
@@ -0,0 +1,69 @@
+#pragma once
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+
+
+#include <cinttypes>
+
+
+namespace lr {
+namespace SDCardEmulator {
+
+
+/// Load the card image and attach the emulated SDHC card to the simulated SPI bus.
+///
+/// The image should use the MicroDisk ("HCDI" or "HCD2") layout. Its size is rounded
+/// up to the next full block.
+///
+/// @param path The path to the image file.
+/// @return true on success, false if the image could not be read.
+///
+bool initialize(const char *path);
+
+/// Set the time the card needs to leave the idle state after the first ACMD41.
+///
+/// @param milliseconds The initialization time in milliseconds.
+///
+void setInitializationTime(uint32_t milliseconds);
+
+/// Set the latency until the data token of a block is sent.
+///
+/// This is the access time after CMD17/CMD18, and the time between two blocks
+/// of a multiple block read.
+///
+/// @param microseconds The latency in microseconds.
+///
+void setTokenLatency(uint32_t microseconds);
+
+/// Set the time the card signals busy after CMD12.
+///
+/// @param microseconds The busy time in microseconds.
+///
+void setBusyLatency(uint32_t microseconds);
+
+/// Add an additional stall to every n-th block of a read.
+///
+/// This simulates the internal housekeeping of real cards, which causes rare
+/// but long delays.
+///
+/// @param interval The number of blocks between two stalls, 0 to disable.
+/// @param microseconds The additional latency in microseconds.
+///
+void setStall(uint32_t interval, uint32_t microseconds);
+
+/// Answer every n-th data block of a read with an error token.
+///
+/// The card aborts the read, like after an uncorrectable ECC error, and
+/// waits for the next command.
+///
+/// @param interval The number of data tokens between two errors, 0 to disable.
+///
+void setReadErrors(uint32_t interval);
+
+
+}
+}
+
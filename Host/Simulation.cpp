@@ -0,0 +1,1143 @@
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+#include "Simulation.h"
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+
+/// The interrupt handlers of the firmware.
+///
+extern "C" void lrOnUART(void);
+extern "C" void lrOnFTM0(void);
+extern "C" void lrOnFTM2(void);
+
+
+namespace lr {
+namespace Simulation {
+
+
+// Constants
+// ---------
+
+/// A cycle value which is never reached.
+///
+const uint64_t cNever = UINT64_MAX;
+
+/// The pins on port A (see SimpleIO.cpp for the schema).
+///
+const uint32_t cSdCardCsBits = 0x00002000U;
+const uint32_t cSignalBits = 0x00000004U;
+const uint32_t cAudioValueBits = 0x000fc000U;
+const uint8_t cAudioValueShift = 14;
+const uint32_t cAudioEnabledBits = 0x00000008U;
+
+/// The maximum number of additional report sections.
+///
+const uint8_t cMaximumReports = 4;
+
+/// The sample rate for the recorded audio output.
+///
+const uint32_t cAudioOutputRate = 44100;
+
+/// The cycles to mask or unmask the interrupts (PE EnterCritical/ExitCritical).
+///
+const uint32_t cCriticalCycles = 3;
+
+/// The cycles for one character on the serial line if the baud rate is 115200.
+///
+const uint32_t cSerialInputCharacterCycles = 10 * 16 * 13 * (cCoreClock / cBusClock);
+
+/// The asynchronous ADC clock in Hz (low power / normal).
+///
+const uint32_t cAdcAsyncClockLowPower = 3300000;
+const uint32_t cAdcAsyncClock = 4400000;
+
+/// The ADC clock cycles for one conversion with short sample time.
+///
+const uint32_t cAdcConversionClocks = 20;
+
+/// The additional ADC clock cycles for the long sample time.
+///
+const uint32_t cAdcLongSampleClocks = 20;
+
+
+// Component Variables
+// -------------------
+
+/// A flexible timer module.
+///
+struct Timer {
+	uint32_t sc; ///< The status and control register (without TOF).
+	bool overflow; ///< The TOF flag.
+	uint32_t cnt; ///< The counter.
+	uint32_t mod; ///< The modulo value.
+	uint32_t cntin; ///< The initial value for the counter.
+	uint64_t lastCycle; ///< The cycle of the last update.
+	uint64_t accumulator; ///< The fraction of the next tick.
+};
+
+/// A serial input character.
+///
+struct SerialInput {
+	uint64_t cycle; ///< The cycle when the character arrives.
+	char character; ///< The character.
+};
+
+/// The current cycle.
+///
+uint64_t _cycles = 0;
+
+/// The cycle of the next peripheral event.
+///
+uint64_t _nextEventCycle = 0;
+
+/// The cycle when the simulation ends.
+///
+uint64_t _timeLimitCycle = cNever;
+
+/// The nesting level of the critical sections.
+///
+uint8_t _criticalNesting = 0;
+
+/// The cycle when the interrupts were masked.
+///
+uint64_t _criticalStartCycle = 0;
+
+/// Flag if the code is running in an interrupt handler.
+///
+bool _inHandler = false;
+
+/// The collected statistics.
+///
+Statistics _statistics;
+
+/// The additional report sections.
+///
+ReportFunction _reports[cMaximumReports];
+uint8_t _reportCount = 0;
+
+/// The system integration module.
+///
+uint32_t _simScgc = 0;
+uint32_t _simPinsel = 0;
+uint32_t _simSopt0 = 0;
+
+/// The GPIO port A.
+///
+uint32_t _gpioPdor = 0;
+uint32_t _gpioPddr = 0;
+bool _chipSelected = false;
+
+/// The timer modules FTM0 (index 0) and FTM2 (index 1).
+///
+Timer _timers[2];
+
+/// The SPI module.
+///
+uint32_t _spiC1 = 0;
+uint32_t _spiC2 = 0;
+uint32_t _spiBr = 0;
+bool _spiReceiveFull = false;
+uint8_t _spiReceiveData = 0;
+bool _spiTransmitFull = false;
+uint8_t _spiTransmitData = 0;
+bool _spiShifterBusy = false;
+uint8_t _spiShifterData = 0;
+uint64_t _spiShifterDoneCycle = 0;
+SpiExchange _spiExchange = nullptr;
+ChipSelectHandler _chipSelectHandler = nullptr;
+
+/// The ADC module.
+///
+uint32_t _adcSc1 = 0x1f;
+uint32_t _adcSc2 = 0;
+uint32_t _adcSc3 = 0;
+uint32_t _adcSc4 = 0;
+uint32_t _adcSc5 = 0;
+uint32_t _adcApctl1 = 0;
+bool _adcComplete = false;
+bool _adcConverting = false;
+uint64_t _adcDoneCycle = 0;
+uint16_t _adcResult = 0;
+uint8_t _adcFifoChannels[8] = {};
+uint8_t _adcFifoChannelCount = 0;
+uint8_t _adcFifoConversionIndex = 0;
+uint16_t _adcFifoResults[8] = {};
+uint8_t _adcFifoResultCount = 0;
+uint8_t _adcFifoReadIndex = 0;
+AnalogInput _analogInput = nullptr;
+
+/// The UART module.
+///
+uint32_t _uartBdh = 0;
+uint32_t _uartBdl = 4;
+uint32_t _uartC1 = 0;
+uint32_t _uartC2 = 0;
+uint32_t _uartC3 = 0;
+uint32_t _uartS2 = 0;
+bool _uartTransmitFull = false;
+uint8_t _uartTransmitData = 0;
+bool _uartShifterBusy = false;
+uint64_t _uartShifterDoneCycle = 0;
+bool _uartReceiveFull = false;
+uint8_t _uartReceiveData = 0;
+std::deque<SerialInput> _serialInput;
+
+/// The recorded audio output.
+///
+FILE *_audioFile = nullptr;
+uint64_t _audioSampleIndex = 0;
+uint64_t _nextAudioSampleCycle = cNever;
+
+
+// Forward declarations
+void processEvents();
+
+
+// Timer
+// -----
+
+/// Get the counter clock of a timer in Hz, or zero if the timer is stopped.
+///
+uint32_t timerClock(const Timer &timer)
+{
+	switch ((timer.sc >> 3) & 0x3) {
+	case 1:
+		return cBusClock;
+	case 2:
+		return cFixedClock;
+	default:
+		return 0;
+	}
+}
+
+
+/// Get the core cycles multiplied with the clock for one counter tick.
+///
+inline uint64_t timerTickUnit(const Timer &timer)
+{
+	return static_cast<uint64_t>(cCoreClock) << (timer.sc & 0x7);
+}
+
+
+/// Update the timer to the current cycle.
+///
+/// @return true if the counter overflowed since the last update.
+///
+bool timerUpdate(Timer &timer)
+{
+	const uint32_t clock = timerClock(timer);
+	if (clock == 0) {
+		timer.lastCycle = _cycles;
+		return false;
+	}
+	timer.accumulator += (_cycles - timer.lastCycle) * clock;
+	timer.lastCycle = _cycles;
+	const uint64_t unit = timerTickUnit(timer);
+	uint64_t ticks = timer.accumulator / unit;
+	timer.accumulator %= unit;
+	if (timer.cnt > timer.mod) {
+		timer.cnt = timer.cntin;
+	}
+	const uint64_t ticksToOverflow = timer.mod - timer.cnt + 1;
+	if (ticks >= ticksToOverflow) {
+		timer.overflow = true;
+		ticks -= ticksToOverflow;
+		const uint64_t period = timer.mod - timer.cntin + 1;
+		timer.cnt = timer.cntin + static_cast<uint32_t>(ticks % period);
+		return true;
+	}
+	timer.cnt += static_cast<uint32_t>(ticks);
+	return false;
+}
+
+
+/// Get the cycle of the next overflow, or cNever if there is no interrupt for it.
+///
+uint64_t timerNextEvent(const Timer &timer)
+{
+	const uint32_t clock = timerClock(timer);
+	if (clock == 0 || (timer.sc & 0x40) == 0 || timer.overflow) {
+		return cNever;
+	}
+	const uint64_t ticksToOverflow = (timer.cnt > timer.mod) ? 1 : (timer.mod - timer.cnt + 1);
+	const uint64_t needed = ticksToOverflow * timerTickUnit(timer) - timer.accumulator;
+	return _cycles + (needed + clock - 1) / clock;
+}
+
+
+uint32_t timerRead(Timer &timer, RegisterId id, RegisterId base)
+{
+	switch (id - base) {
+	case 0:
+		return timer.sc | (timer.overflow ? 0x80 : 0);
+	case 1:
+		return timer.cnt;
+	case 2:
+		return timer.mod;
+	default:
+		return 0;
+	}
+}
+
+
+void timerWrite(Timer &timer, RegisterId id, RegisterId base, uint32_t value)
+{
+	switch (id - base) {
+	case 0:
+		// Writing zero to TOF clears the flag, writing one has no effect.
+		if ((value & 0x80) == 0) {
+			timer.overflow = false;
+		}
+		if (((timer.sc ^ value) & 0x1f) != 0) {
+			timer.accumulator = 0;
+		}
+		timer.sc = value & 0x7f;
+		break;
+	case 1:
+		// Writing any value to CNT loads the initial value.
+		timer.cnt = timer.cntin;
+		timer.accumulator = 0;
+		break;
+	case 2:
+		timer.mod = value & 0xffff;
+		break;
+	default:
+		break;
+	}
+}
+
+
+// GPIO
+// ----
+
+void gpioWrite(uint32_t value)
+{
+	const uint32_t changes = _gpioPdor ^ value;
+	_gpioPdor = value;
+	if ((changes & cAudioValueBits) != 0) {
+		++_statistics.audioValueWrites;
+	}
+	const bool selected = ((_gpioPddr & cSdCardCsBits) != 0 && (_gpioPdor & cSdCardCsBits) == 0);
+	if (selected != _chipSelected) {
+		_chipSelected = selected;
+		if (_chipSelectHandler != nullptr) {
+			_chipSelectHandler(selected);
+		}
+	}
+}
+
+
+void audioUpdate()
+{
+	while (_cycles >= _nextAudioSampleCycle) {
+		uint8_t sample = 0x80;
+		if ((_gpioPdor & cAudioEnabledBits) == 0) {
+			sample = static_cast<uint8_t>(((_gpioPdor & cAudioValueBits) >> cAudioValueShift) << 2);
+		}
+		std::fputc(sample, _audioFile);
+		++_audioSampleIndex;
+		_nextAudioSampleCycle = (_audioSampleIndex * cCoreClock) / cAudioOutputRate;
+	}
+}
+
+
+// SPI
+// ---
+
+uint32_t spiByteCycles()
+{
+	const uint32_t prescaler = ((_spiBr >> 4) & 0x7) + 1;
+	const uint32_t divisor = prescaler << ((_spiBr & 0xf) + 1);
+	return divisor * 8 * (cCoreClock / cBusClock);
+}
+
+
+void spiStartShift(uint8_t mosi, uint64_t startCycle)
+{
+	_spiShifterData = (_spiExchange != nullptr) ? _spiExchange(mosi) : 0xff;
+	_spiShifterBusy = true;
+	_spiShifterDoneCycle = startCycle + spiByteCycles();
+	++_statistics.spiBytes;
+}
+
+
+void spiUpdate()
+{
+	while (_spiShifterBusy && _cycles >= _spiShifterDoneCycle) {
+		_spiReceiveData = _spiShifterData;
+		_spiReceiveFull = true;
+		_spiShifterBusy = false;
+		if (_spiTransmitFull) {
+			_spiTransmitFull = false;
+			spiStartShift(_spiTransmitData, _spiShifterDoneCycle);
+		}
+	}
+}
+
+
+void spiWriteData(uint8_t value)
+{
+	if ((_spiC1 & 0x40) == 0) {
+		return;
+	}
+	if (!_spiShifterBusy) {
+		spiStartShift(value, _cycles);
+	} else if (!_spiTransmitFull) {
+		_spiTransmitFull = true;
+		_spiTransmitData = value;
+	}
+}
+
+
+// ADC
+// ---
+
+uint32_t adcConversionCycles()
+{
+	uint32_t clock;
+	switch (_adcSc3 & 0x3) {
+	case 1:
+		clock = cBusClock / 2;
+		break;
+	case 3:
+		clock = ((_adcSc3 & 0x80) != 0) ? cAdcAsyncClockLowPower : cAdcAsyncClock;
+		break;
+	default:
+		clock = cBusClock;
+		break;
+	}
+	clock >>= ((_adcSc3 >> 5) & 0x3);
+	uint32_t adcClocks = cAdcConversionClocks;
+	if ((_adcSc3 & 0x10) != 0) {
+		adcClocks += cAdcLongSampleClocks;
+	}
+	return static_cast<uint32_t>((static_cast<uint64_t>(adcClocks) * cCoreClock) / clock);
+}
+
+
+/// Get the depth of the FIFO, 0 if the FIFO is disabled.
+///
+uint8_t adcFifoDepth()
+{
+	const uint8_t afdep = _adcSc4 & 0x7;
+	return (afdep == 0) ? 0 : afdep + 1;
+}
+
+
+/// Convert the analog input of a channel.
+///
+uint16_t adcConvert(uint8_t channel)
+{
+	uint16_t value = 0;
+	if (_analogInput != nullptr) {
+		value = _analogInput(channel, (_gpioPdor & cSignalBits) != 0) & 0xfff;
+	}
+	// Reduce the result to the configured resolution.
+	switch ((_adcSc3 >> 2) & 0x3) {
+	case 0:
+		value >>= 4;
+		break;
+	case 1:
+		value >>= 2;
+		break;
+	default:
+		break;
+	}
+	++_statistics.adcConversions;
+	return value;
+}
+
+
+void adcUpdate()
+{
+	if (_adcConverting && _cycles >= _adcDoneCycle) {
+		if (adcFifoDepth() > 0) {
+			// The channels in the FIFO are converted one after the other.
+			_adcFifoResults[_adcFifoResultCount++] = adcConvert(_adcFifoChannels[_adcFifoConversionIndex++]);
+			if (_adcFifoConversionIndex < _adcFifoChannelCount) {
+				_adcDoneCycle += adcConversionCycles();
+				return;
+			}
+			_adcFifoChannelCount = 0;
+			_adcFifoReadIndex = 0;
+		} else {
+			_adcResult = adcConvert(_adcSc1 & 0x1f);
+		}
+		_adcComplete = true;
+		_adcConverting = false;
+	}
+}
+
+
+/// Read the next result, from the FIFO if it is enabled.
+///
+uint16_t adcReadResult()
+{
+	if (adcFifoDepth() == 0) {
+		_adcComplete = false;
+		return _adcResult;
+	}
+	if (_adcFifoReadIndex >= _adcFifoResultCount) {
+		return 0;
+	}
+	const uint16_t result = _adcFifoResults[_adcFifoReadIndex++];
+	if (_adcFifoReadIndex == _adcFifoResultCount) {
+		// The result FIFO is empty.
+		_adcComplete = false;
+		_adcFifoResultCount = 0;
+		_adcFifoReadIndex = 0;
+	}
+	return result;
+}
+
+
+void adcWriteStatusControl1(uint32_t value)
+{
+	_adcSc1 = value & 0x7f;
+	_adcComplete = false;
+	const uint8_t fifoDepth = adcFifoDepth();
+	if (fifoDepth > 0) {
+		// The channels are added to the FIFO, the conversions start if it is full.
+		if ((value & 0x1f) == 0x1f) {
+			_adcConverting = false;
+			_adcFifoChannelCount = 0;
+		} else if (!_adcConverting && _adcFifoChannelCount < fifoDepth) {
+			if (_adcFifoChannelCount == 0) {
+				_adcFifoResultCount = 0;
+				_adcFifoReadIndex = 0;
+			}
+			_adcFifoChannels[_adcFifoChannelCount++] = static_cast<uint8_t>(value & 0x1f);
+			if (_adcFifoChannelCount == fifoDepth && (_adcSc2 & 0x40) == 0) {
+				_adcFifoConversionIndex = 0;
+				_adcConverting = true;
+				_adcDoneCycle = _cycles + adcConversionCycles();
+			}
+		}
+	} else if ((value & 0x1f) != 0x1f) {
+		// With the hardware trigger, the conversion starts with the trigger.
+		if ((_adcSc2 & 0x40) == 0) {
+			_adcConverting = true;
+			_adcDoneCycle = _cycles + adcConversionCycles();
+		}
+	} else {
+		_adcConverting = false;
+	}
+}
+
+
+/// Handle an overflow of FTM0, which is a hardware trigger source of the ADC.
+///
+/// In FIFO mode, only the hardware trigger multiple conversion mode (HTRGME)
+/// is simulated, where one trigger converts all channels in the FIFO.
+///
+void adcHardwareTrigger()
+{
+	if ((_adcSc2 & 0x40) == 0 || ((_simSopt0 >> 8) & 0x7) != 1 || _adcConverting) {
+		return; // No hardware trigger from FTM0, or the trigger is ignored.
+	}
+	if ((_adcSc5 & 0x2) != 0) {
+		return; // The trigger is masked.
+	}
+	const uint8_t fifoDepth = adcFifoDepth();
+	if (fifoDepth > 0) {
+		if ((_adcSc5 & 0x1) != 0 && _adcFifoResultCount > _adcFifoReadIndex) {
+			return; // The trigger is masked automatically while the result FIFO is not empty.
+		}
+		if ((_adcSc4 & 0x100) == 0 || _adcFifoChannelCount < fifoDepth) {
+			return;
+		}
+		_adcFifoResultCount = 0;
+		_adcFifoReadIndex = 0;
+		_adcFifoConversionIndex = 0;
+	} else if ((_adcSc1 & 0x1f) == 0x1f) {
+		return;
+	}
+	_adcComplete = false;
+	_adcConverting = true;
+	_adcDoneCycle = _cycles + adcConversionCycles();
+}
+
+
+// UART
+// ----
+
+uint32_t uartCharacterCycles()
+{
+	uint32_t sbr = ((_uartBdh & 0x1f) << 8) | _uartBdl;
+	if (sbr == 0) {
+		sbr = 1;
+	}
+	return 10 * 16 * sbr * (cCoreClock / cBusClock);
+}
+
+
+void uartStartShift(uint8_t data, uint64_t startCycle)
+{
+	if (data != '\r') {
+		std::fputc(data, stdout);
+	}
+	++_statistics.uartSentBytes;
+	_uartShifterBusy = true;
+	_uartShifterDoneCycle = startCycle + uartCharacterCycles();
+}
+
+
+void uartUpdate()
+{
+	while (_uartShifterBusy && _cycles >= _uartShifterDoneCycle) {
+		_uartShifterBusy = false;
+		if (_uartTransmitFull) {
+			_uartTransmitFull = false;
+			uartStartShift(_uartTransmitData, _uartShifterDoneCycle);
+		}
+	}
+	while (!_serialInput.empty() && _serialInput.front().cycle <= _cycles) {
+		// Characters are lost if the receiver is disabled or the last one was not read (overrun).
+		if ((_uartC2 & 0x04) != 0 && !_uartReceiveFull) {
+			_uartReceiveData = _serialInput.front().character;
+			_uartReceiveFull = true;
+		}
+		_serialInput.pop_front();
+	}
+}
+
+
+void uartWriteData(uint8_t value)
+{
+	if ((_uartC2 & 0x08) == 0) {
+		return;
+	}
+	if (!_uartShifterBusy) {
+		uartStartShift(value, _cycles);
+	} else if (!_uartTransmitFull) {
+		_uartTransmitFull = true;
+		_uartTransmitData = value;
+	}
+}
+
+
+// Interrupts
+// ----------
+
+bool isPending(Vector vector)
+{
+	switch (vector) {
+	case Vector_UART0:
+		return ((_uartC2 & 0x20) != 0 && _uartReceiveFull) || ((_uartC2 & 0x80) != 0 && !_uartTransmitFull);
+	case Vector_FTM0:
+		return (_timers[0].sc & 0x40) != 0 && _timers[0].overflow;
+	case Vector_FTM2:
+		return (_timers[1].sc & 0x40) != 0 && _timers[1].overflow;
+	default:
+		return false;
+	}
+}
+
+
+bool isAnyPending()
+{
+	for (uint8_t vector = 0; vector < Vector_Count; ++vector) {
+		if (isPending(static_cast<Vector>(vector))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void updatePeripherals()
+{
+	if (timerUpdate(_timers[0])) {
+		adcHardwareTrigger();
+	}
+	timerUpdate(_timers[1]);
+	spiUpdate();
+	adcUpdate();
+	uartUpdate();
+	if (_audioFile != nullptr) {
+		audioUpdate();
+	}
+}
+
+
+void scheduleNextEvent()
+{
+	uint64_t next = _timeLimitCycle;
+	next = std::min(next, timerNextEvent(_timers[0]));
+	next = std::min(next, timerNextEvent(_timers[1]));
+	if (_spiShifterBusy) {
+		next = std::min(next, _spiShifterDoneCycle);
+	}
+	if (_adcConverting) {
+		next = std::min(next, _adcDoneCycle);
+	}
+	if (_uartShifterBusy) {
+		next = std::min(next, _uartShifterDoneCycle);
+	}
+	if (!_serialInput.empty()) {
+		next = std::min(next, _serialInput.front().cycle);
+	}
+	next = std::min(next, _nextAudioSampleCycle);
+	_nextEventCycle = next;
+}
+
+
+void dispatchInterrupts()
+{
+	if (_inHandler || _criticalNesting > 0) {
+		return;
+	}
+	for (;;) {
+		uint8_t vector = 0;
+		while (vector < Vector_Count && !isPending(static_cast<Vector>(vector))) {
+			++vector;
+		}
+		if (vector == Vector_Count) {
+			return;
+		}
+		const uint64_t startCycle = _cycles;
+		_inHandler = true;
+		_cycles += cInterruptEntryCycles;
+		switch (vector) {
+		case Vector_UART0:
+			lrOnUART();
+			break;
+		case Vector_FTM0:
+			lrOnFTM0();
+			break;
+		case Vector_FTM2:
+			lrOnFTM2();
+			break;
+		}
+		_cycles += cInterruptExitCycles;
+		_inHandler = false;
+		InterruptStatistics &interrupt = _statistics.interrupts[vector];
+		const uint32_t handlerCycles = static_cast<uint32_t>(_cycles - startCycle);
+		++interrupt.count;
+		interrupt.totalCycles += handlerCycles;
+		interrupt.maximumCycles = std::max(interrupt.maximumCycles, handlerCycles);
+		updatePeripherals();
+		if (_cycles >= _timeLimitCycle) {
+			finish();
+		}
+	}
+}
+
+
+void processEvents()
+{
+	updatePeripherals();
+	if (_cycles >= _timeLimitCycle) {
+		finish();
+	}
+	dispatchInterrupts();
+	scheduleNextEvent();
+}
+
+
+// Interface Functions
+// -------------------
+
+uint32_t readRegister(RegisterId id)
+{
+	advance(cRegisterAccessCycles);
+	updatePeripherals();
+	uint32_t result = 0;
+	switch (id) {
+	case Register_SIM_SCGC:
+		result = _simScgc;
+		break;
+	case Register_SIM_PINSEL:
+		result = _simPinsel;
+		break;
+	case Register_SIM_SOPT0:
+		result = _simSopt0;
+		break;
+	case Register_GPIOA_PDOR:
+	case Register_GPIOA_PDIR:
+		result = _gpioPdor;
+		break;
+	case Register_GPIOA_PDDR:
+		result = _gpioPddr;
+		break;
+	case Register_FTM0_SC:
+	case Register_FTM0_CNT:
+	case Register_FTM0_MOD:
+		result = timerRead(_timers[0], id, Register_FTM0_SC);
+		break;
+	case Register_FTM2_SC:
+	case Register_FTM2_CNT:
+	case Register_FTM2_MOD:
+		result = timerRead(_timers[1], id, Register_FTM2_SC);
+		break;
+	case Register_FTM2_CNTIN:
+		result = _timers[1].cntin;
+		break;
+	case Register_SPI0_C1:
+		result = _spiC1;
+		break;
+	case Register_SPI0_C2:
+		result = _spiC2;
+		break;
+	case Register_SPI0_BR:
+		result = _spiBr;
+		break;
+	case Register_SPI0_S:
+		result = (_spiReceiveFull ? 0x80 : 0) | (_spiTransmitFull ? 0 : 0x20);
+		break;
+	case Register_SPI0_D:
+		_spiReceiveFull = false;
+		result = _spiReceiveData;
+		break;
+	case Register_ADC_SC1:
+		result = _adcSc1 | (_adcComplete ? 0x80 : 0);
+		break;
+	case Register_ADC_SC2:
+		result = _adcSc2 | (_adcConverting ? 0x80 : 0) | (_adcComplete ? 0 : 0x08) |
+			((adcFifoDepth() > 0 && _adcFifoResultCount - _adcFifoReadIndex == adcFifoDepth()) ? 0x04 : 0);
+		break;
+	case Register_ADC_SC3:
+		result = _adcSc3;
+		break;
+	case Register_ADC_SC4:
+		result = _adcSc4;
+		break;
+	case Register_ADC_SC5:
+		result = _adcSc5;
+		break;
+	case Register_ADC_R:
+		result = adcReadResult();
+		break;
+	case Register_ADC_APCTL1:
+		result = _adcApctl1;
+		break;
+	case Register_UART0_BDH:
+		result = _uartBdh;
+		break;
+	case Register_UART0_BDL:
+		result = _uartBdl;
+		break;
+	case Register_UART0_C1:
+		result = _uartC1;
+		break;
+	case Register_UART0_C2:
+		result = _uartC2;
+		break;
+	case Register_UART0_C3:
+		result = _uartC3;
+		break;
+	case Register_UART0_S1:
+		result = (_uartTransmitFull ? 0 : 0x80) | ((_uartTransmitFull || _uartShifterBusy) ? 0 : 0x40) | (_uartReceiveFull ? 0x20 : 0);
+		break;
+	case Register_UART0_S2:
+		result = _uartS2;
+		break;
+	case Register_UART0_D:
+		_uartReceiveFull = false;
+		result = _uartReceiveData;
+		break;
+	default:
+		break;
+	}
+	scheduleNextEvent();
+	return result;
+}
+
+
+void writeRegister(RegisterId id, uint32_t value)
+{
+	advance(cRegisterAccessCycles);
+	updatePeripherals();
+	switch (id) {
+	case Register_SIM_SCGC:
+		_simScgc = value;
+		break;
+	case Register_SIM_PINSEL:
+		_simPinsel = value;
+		break;
+	case Register_SIM_SOPT0:
+		_simSopt0 = value;
+		break;
+	case Register_GPIOA_PDOR:
+		gpioWrite(value);
+		break;
+	case Register_GPIOA_PSOR:
+		gpioWrite(_gpioPdor | value);
+		break;
+	case Register_GPIOA_PCOR:
+		gpioWrite(_gpioPdor & ~value);
+		break;
+	case Register_GPIOA_PTOR:
+		gpioWrite(_gpioPdor ^ value);
+		break;
+	case Register_GPIOA_PDDR:
+		_gpioPddr = value;
+		gpioWrite(_gpioPdor);
+		break;
+	case Register_FTM0_SC:
+	case Register_FTM0_CNT:
+	case Register_FTM0_MOD:
+		timerWrite(_timers[0], id, Register_FTM0_SC, value);
+		break;
+	case Register_FTM2_SC:
+	case Register_FTM2_CNT:
+	case Register_FTM2_MOD:
+		timerWrite(_timers[1], id, Register_FTM2_SC, value);
+		break;
+	case Register_FTM2_CNTIN:
+		_timers[1].cntin = value & 0xffff;
+		break;
+	case Register_SPI0_C1:
+		_spiC1 = value & 0xff;
+		break;
+	case Register_SPI0_C2:
+		_spiC2 = value & 0xff;
+		break;
+	case Register_SPI0_BR:
+		_spiBr = value & 0x7f;
+		break;
+	case Register_SPI0_D:
+		spiWriteData(static_cast<uint8_t>(value));
+		break;
+	case Register_ADC_SC1:
+		adcWriteStatusControl1(value);
+		break;
+	case Register_ADC_SC2:
+		_adcSc2 = value & 0x70;
+		break;
+	case Register_ADC_SC3:
+		_adcSc3 = value & 0xff;
+		break;
+	case Register_ADC_SC4:
+		_adcSc4 = value & 0x1ff;
+		break;
+	case Register_ADC_SC5:
+		_adcSc5 = value & 0x3;
+		break;
+	case Register_ADC_APCTL1:
+		_adcApctl1 = value & 0xffff;
+		break;
+	case Register_UART0_BDH:
+		_uartBdh = value & 0xff;
+		break;
+	case Register_UART0_BDL:
+		_uartBdl = value & 0xff;
+		break;
+	case Register_UART0_C1:
+		_uartC1 = value & 0xff;
+		break;
+	case Register_UART0_C2:
+		_uartC2 = value & 0xff;
+		break;
+	case Register_UART0_C3:
+		_uartC3 = value & 0xff;
+		break;
+	case Register_UART0_S2:
+		_uartS2 = value & 0x3f;
+		break;
+	case Register_UART0_D:
+		uartWriteData(static_cast<uint8_t>(value));
+		break;
+	default:
+		// Channel and mode registers are stored without function.
+		break;
+	}
+	scheduleNextEvent();
+}
+
+
+void initialize()
+{
+	_cycles = 0;
+	_criticalNesting = 0;
+	_inHandler = false;
+	std::memset(&_statistics, 0, sizeof(_statistics));
+	std::memset(_timers, 0, sizeof(_timers));
+	_timers[0].mod = 0xffff;
+	_timers[1].mod = 0xffff;
+	_serialInput.clear();
+	scheduleNextEvent();
+}
+
+
+void setTimeLimit(uint32_t milliseconds)
+{
+	_timeLimitCycle = static_cast<uint64_t>(milliseconds) * (cCoreClock / 1000);
+	scheduleNextEvent();
+}
+
+
+void setSpiDevice(SpiExchange exchange, ChipSelectHandler chipSelect)
+{
+	_spiExchange = exchange;
+	_chipSelectHandler = chipSelect;
+}
+
+
+void setAnalogInput(AnalogInput analogInput)
+{
+	_analogInput = analogInput;
+}
+
+
+void queueSerialInput(uint32_t milliseconds, const char *text)
+{
+	uint64_t cycle = static_cast<uint64_t>(milliseconds) * (cCoreClock / 1000);
+	if (!_serialInput.empty()) {
+		cycle = std::max(cycle, _serialInput.back().cycle + cSerialInputCharacterCycles);
+	}
+	for (; *text != '\0'; ++text) {
+		SerialInput input;
+		input.cycle = cycle;
+		input.character = *text;
+		_serialInput.push_back(input);
+		cycle += cSerialInputCharacterCycles;
+	}
+	scheduleNextEvent();
+}
+
+
+bool setAudioOutput(const char *path)
+{
+	_audioFile = std::fopen(path, "wb");
+	if (_audioFile == nullptr) {
+		return false;
+	}
+	_audioSampleIndex = 0;
+	_nextAudioSampleCycle = _cycles;
+	scheduleNextEvent();
+	return true;
+}
+
+
+uint64_t cycles()
+{
+	return _cycles;
+}
+
+
+void advance(uint32_t cycleCount)
+{
+	_cycles += cycleCount;
+	if (_cycles >= _nextEventCycle) {
+		processEvents();
+	}
+}
+
+
+void waitForInterrupt()
+{
+	updatePeripherals();
+	// A pending interrupt wakes up the core immediately.
+	if (!isAnyPending()) {
+		uint64_t wakeCycle = std::min(timerNextEvent(_timers[0]), timerNextEvent(_timers[1]));
+		if ((_uartC2 & 0x24) == 0x24 && !_serialInput.empty()) {
+			wakeCycle = std::min(wakeCycle, _serialInput.front().cycle);
+		}
+		if ((_uartC2 & 0x80) != 0 && _uartShifterBusy) {
+			wakeCycle = std::min(wakeCycle, _uartShifterDoneCycle);
+		}
+		if (wakeCycle == cNever) {
+			std::fprintf(stderr, "Simulation: WFI without any wake-up source.\n");
+			finish();
+		}
+		wakeCycle = std::min(wakeCycle, _timeLimitCycle);
+		_statistics.sleepCycles += wakeCycle - _cycles;
+		_cycles = wakeCycle;
+	}
+	processEvents();
+}
+
+
+void enterCritical()
+{
+	advance(cCriticalCycles);
+	if (_criticalNesting == 0) {
+		_criticalStartCycle = _cycles;
+	}
+	++_criticalNesting;
+}
+
+
+void exitCritical()
+{
+	--_criticalNesting;
+	if (_criticalNesting == 0) {
+		_statistics.criticalCycles += _cycles - _criticalStartCycle;
+	}
+	advance(cCriticalCycles);
+	processEvents();
+}
+
+
+void addReport(ReportFunction report)
+{
+	if (_reportCount < cMaximumReports) {
+		_reports[_reportCount++] = report;
+	}
+}
+
+
+const Statistics& statistics()
+{
+	return _statistics;
+}
+
+
+/// Print a cycle count as milliseconds.
+///
+void printMilliseconds(const char *label, uint64_t cycleCount)
+{
+	std::fprintf(stderr, "  %-22s %12.3f ms\n", label, static_cast<double>(cycleCount) * 1000.0 / cCoreClock);
+}
+
+
+void printReport()
+{
+	const char *vectorNames[Vector_Count] = {"UART0", "FTM0", "FTM2"};
+	std::fflush(stdout);
+	std::fprintf(stderr, "\n--- Simulation report ---\n");
+	printMilliseconds("Simulated time:", _cycles);
+	printMilliseconds("Sleeping (WFI):", _statistics.sleepCycles);
+	printMilliseconds("Interrupts masked:", _statistics.criticalCycles);
+	std::fprintf(stderr, "  %-22s %12u\n", "SPI bytes:", _statistics.spiBytes);
+	std::fprintf(stderr, "  %-22s %12u\n", "ADC conversions:", _statistics.adcConversions);
+	std::fprintf(stderr, "  %-22s %12u\n", "Serial bytes sent:", _statistics.uartSentBytes);
+	std::fprintf(stderr, "  %-22s %12u\n", "Audio value changes:", _statistics.audioValueWrites);
+	std::fprintf(stderr, "  %-8s %10s %14s %12s %12s\n", "Vector", "Calls", "Total cycles", "Avg cycles", "Max cycles");
+	for (uint8_t vector = 0; vector < Vector_Count; ++vector) {
+		const InterruptStatistics &interrupt = _statistics.interrupts[vector];
+		const uint64_t average = (interrupt.count > 0) ? (interrupt.totalCycles / interrupt.count) : 0;
+		std::fprintf(stderr, "  %-8s %10u %14llu %12llu %12u\n", vectorNames[vector], interrupt.count,
+			static_cast<unsigned long long>(interrupt.totalCycles), static_cast<unsigned long long>(average),
+			interrupt.maximumCycles);
+	}
+	for (uint8_t i = 0; i < _reportCount; ++i) {
+		_reports[i]();
+	}
+}
+
+
+void finish()
+{
+	printReport();
+	if (_audioFile != nullptr) {
+		std::fclose(_audioFile);
+		_audioFile = nullptr;
+	}
+	std::exit(0);
+}
+
+
+}
+}
+
@@ -0,0 +1,271 @@
+#pragma once
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+
+
+#include <cinttypes>
+
+
+namespace lr {
+namespace Simulation {
+
+
+/// The simulated core clock of the MKE04Z8 in Hz.
+///
+const uint32_t cCoreClock = 48000000;
+
+/// The simulated bus clock in Hz, this is the "system clock" for FTM, SPI, UART and ADC.
+///
+const uint32_t cBusClock = 24000000;
+
+/// The fixed frequency clock in Hz (FTM clock source 2).
+///
+const uint32_t cFixedClock = 37000;
+
+/// The cycles for one PE_NOP() call.
+/// This includes the loop overhead of the unoptimized build, so a loop of 0x300
+/// iterations takes the ~100us the detector code expects.
+///
+const uint32_t cNopCycles = 6;
+
+/// The cycles for a single access to a peripheral register.
+///
+const uint32_t cRegisterAccessCycles = 2;
+
+/// The cycles for the exception entry of the Cortex-M0+.
+///
+const uint32_t cInterruptEntryCycles = 15;
+
+/// The cycles for the exception return of the Cortex-M0+.
+///
+const uint32_t cInterruptExitCycles = 13;
+
+
+/// All simulated peripheral registers.
+///
+enum RegisterId : uint8_t {
+	Register_SIM_SCGC,
+	Register_SIM_PINSEL,
+	Register_SIM_SOPT0,
+	Register_GPIOA_PDOR,
+	Register_GPIOA_PSOR,
+	Register_GPIOA_PCOR,
+	Register_GPIOA_PTOR,
+	Register_GPIOA_PDIR,
+	Register_GPIOA_PDDR,
+	Register_FTM0_SC,
+	Register_FTM0_CNT,
+	Register_FTM0_MOD,
+	Register_FTM0_C0SC,
+	Register_FTM0_C1SC,
+	Register_FTM2_SC,
+	Register_FTM2_CNT,
+	Register_FTM2_MOD,
+	Register_FTM2_CNTIN,
+	Register_FTM2_MODE,
+	Register_FTM2_C0SC,
+	Register_FTM2_C1SC,
+	Register_FTM2_C2SC,
+	Register_FTM2_C3SC,
+	Register_FTM2_C4SC,
+	Register_FTM2_C5SC,
+	Register_SPI0_C1,
+	Register_SPI0_C2,
+	Register_SPI0_BR,
+	Register_SPI0_S,
+	Register_SPI0_D,
+	Register_ADC_SC1,
+	Register_ADC_SC2,
+	Register_ADC_SC3,
+	Register_ADC_SC4,
+	Register_ADC_SC5,
+	Register_ADC_R,
+	Register_ADC_APCTL1,
+	Register_UART0_BDH,
+	Register_UART0_BDL,
+	Register_UART0_C1,
+	Register_UART0_C2,
+	Register_UART0_C3,
+	Register_UART0_S1,
+	Register_UART0_S2,
+	Register_UART0_D,
+	Register_Count
+};
+
+
+/// The interrupt vectors handled by the simulation.
+///
+enum Vector : uint8_t {
+	Vector_UART0 = 0, ///< lrOnUART
+	Vector_FTM0 = 1, ///< lrOnFTM0
+	Vector_FTM2 = 2, ///< lrOnFTM2
+	Vector_Count
+};
+
+
+/// Read a register with all side effects of the peripheral.
+///
+uint32_t readRegister(RegisterId id);
+
+/// Write a register with all side effects of the peripheral.
+///
+void writeRegister(RegisterId id, uint32_t value);
+
+
+/// A proxy for a single peripheral register.
+///
+/// The register macros in the host "Cpu.h" create instances of this class, so
+/// the firmware code can use the same expressions as on the target.
+///
+class Register
+{
+public:
+	explicit Register(RegisterId id) : _id(id) {}
+	operator uint32_t() const { return readRegister(_id); }
+	Register& operator=(uint32_t value) { writeRegister(_id, value); return *this; }
+	Register& operator|=(uint32_t value) { writeRegister(_id, readRegister(_id) | value); return *this; }
+	Register& operator&=(uint32_t value) { writeRegister(_id, readRegister(_id) & value); return *this; }
+	Register& operator^=(uint32_t value) { writeRegister(_id, readRegister(_id) ^ value); return *this; }
+
+private:
+	RegisterId _id;
+};
+
+
+/// Statistics for one interrupt vector.
+///
+struct InterruptStatistics {
+	uint32_t count; ///< The number of calls.
+	uint64_t totalCycles; ///< The total cycles spent in the handler, including entry and exit.
+	uint32_t maximumCycles; ///< The longest call in cycles.
+};
+
+/// The collected statistics of a simulation run.
+///
+struct Statistics {
+	uint64_t sleepCycles; ///< The cycles spent in WFI.
+	uint64_t criticalCycles; ///< The cycles spent with masked interrupts.
+	uint32_t spiBytes; ///< The number of bytes exchanged on the SPI bus.
+	uint32_t adcConversions; ///< The number of finished ADC conversions.
+	uint32_t uartSentBytes; ///< The number of bytes sent on the serial line.
+	uint32_t audioValueWrites; ///< The number of writes which changed the audio DAC bits.
+	InterruptStatistics interrupts[Vector_Count]; ///< The statistics for each vector.
+};
+
+
+/// The function to exchange one byte with the device on the SPI bus.
+///
+/// @param mosi The byte sent by the controller.
+/// @return The byte sent back by the device.
+///
+typedef uint8_t (*SpiExchange)(uint8_t mosi);
+
+/// The function which is called if the SD card chip select line changes.
+///
+/// @param selected true if the line is low (selected).
+///
+typedef void (*ChipSelectHandler)(bool selected);
+
+/// The function to get the voltage for an ADC conversion.
+///
+/// @param channel The converted ADC channel.
+/// @param signalEnabled The state of the signal LED at the end of the conversion.
+/// @return The 12bit conversion result.
+///
+typedef uint16_t (*AnalogInput)(uint8_t channel, bool signalEnabled);
+
+/// A function which prints an additional section of the report.
+///
+typedef void (*ReportFunction)();
+
+
+/// Initialize the simulation and reset all peripherals.
+///
+void initialize();
+
+/// Set the simulated time after the simulation ends.
+///
+/// @param milliseconds The simulated time in milliseconds.
+///
+void setTimeLimit(uint32_t milliseconds);
+
+/// Attach a device to the SPI bus.
+///
+/// @param exchange The function to exchange bytes with the device.
+/// @param chipSelect The function which is called on chip select changes, or nullptr.
+///
+void setSpiDevice(SpiExchange exchange, ChipSelectHandler chipSelect);
+
+/// Set the source for the analog inputs.
+///
+void setAnalogInput(AnalogInput analogInput);
+
+/// Queue text which is received on the serial line.
+///
+/// The characters arrive one after the other with the timing of the configured baud rate.
+///
+/// @param milliseconds The simulated time when the first character arrives.
+/// @param text The null terminated text.
+///
+void queueSerialInput(uint32_t milliseconds, const char *text);
+
+/// Record the audio output as raw unsigned 8bit samples at 44.1kHz.
+///
+/// @param path The path of the output file.
+/// @return true on success, false if the file could not be created.
+///
+bool setAudioOutput(const char *path);
+
+/// Get the current simulated cycle.
+///
+uint64_t cycles();
+
+/// Convert cycles into microseconds.
+///
+inline uint32_t cyclesToMicroseconds(uint64_t cycles) {
+	return static_cast<uint32_t>(cycles / (cCoreClock / 1000000));
+}
+
+/// Let the simulated time pass.
+///
+/// Processes all peripheral events and dispatches pending interrupts.
+///
+/// @param cycleCount The number of core cycles.
+///
+void advance(uint32_t cycleCount);
+
+/// Sleep until the next interrupt.
+///
+void waitForInterrupt();
+
+/// Mask the interrupts (nested).
+///
+void enterCritical();
+
+/// Unmask the interrupts (nested).
+///
+void exitCritical();
+
+/// Add a section to the report, printed after the simulation statistics.
+///
+void addReport(ReportFunction report);
+
+/// Get the statistics of the current run.
+///
+const Statistics& statistics();
+
+/// Print the report about the run to stderr.
+///
+void printReport();
+
+/// Print the report and end the simulation.
+///
+void finish();
+
+
+}
+}
+
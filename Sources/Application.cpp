@@ -15,9 +15,22 @@
 #include "SimpleTimer.h"
 #include "SimpleSPI.h"
 #include "TimedInterrupt.h"
+#include "TimedInterruptHandler.h"
 
 #include <cstring>
 
+#include <Cpu.h>
+
+
+/// Set this to 1 to prepare the next sound while detecting.
+///
+/// The first samples are read in advance and the SD card stays selected,
+/// so the sound starts immediately after an alarm.
+///
+#ifndef LR_APPLICATION_PREPARE_SOUND
+#define LR_APPLICATION_PREPARE_SOUND 0
+#endif
+
 
 namespace lr {
 namespace Application {
@@ -39,17 +52,13 @@ enum State {
 ///
 uint16_t _nextPlayedFileIndex = 0;
 
-/// The alarm count to trigger recalibration.
+/// The SimpleTimer::ticks() of the last alarm or play command, to measure the start latency.
 ///
-uint8_t _alarmCount = 0;
-
-/// The counter to reset the alarm counter after a quiet time period
-///
-uint8_t _alarmResetCount = 0;
+uint32_t _soundStartTime = 0;
 
 /// A list of commands, each 4 characters long.
 ///
-const char *_commands = "main" "exit" "dump" "play" "cali" "info" "rawd" "help" "\0\0\0\0";
+const char *_commands = "main" "exit" "dump" "play" "cali" "info" "rawd" "help" "stat" "next" "\0\0\0\0";
 
 /// The commands for the code.
 ///
@@ -62,6 +71,8 @@ enum Command : uint8_t {
 	CmdInfo = 5, // Get information about the firmware
 	CmdRawd = 6, // Start raw sensor dump output (use exit to leave the mode.)
 	CmdHelp = 7, // The help command shows all available commands.
+	CmdStat = 8, // Show the playback statistics of the last sound.
+	CmdNext = 9, // Play the next sound after the playing one.
 	CmdUnknown = 0xff
 };
 
@@ -74,7 +85,11 @@ void beginSensorDump();
 void endSensorDump();
 void beginRawSensorDump();
 void endRawSensorDump();
-void playSound();
+const SDCard::DirectoryEntry* nextSoundFile();
+void prepareNextSound();
+bool startNextSound(const char *message);
+void queueNextSound();
+void endSound();
 void sensorDumpMode();
 void rawSensorDumpMode();
 void playingSoundMode();
@@ -82,6 +97,7 @@ void detectingMode();
 void maintenanceMode();
 void errorMode();
 void onBlinkInterrupt();
+void sendStatistics();
 
 
 void initialize()
@@ -126,17 +142,22 @@ void initialize()
 	}
 
 	// Display the contents of the SD card directory.
-	const SDCard::DirectoryEntry *entry = SDCard::fileAtIndex(0);
-	while (entry != nullptr) {
+	const uint16_t fileCount = SDCard::fileCount();
+	for (uint16_t i = 0; i < fileCount; ++i) {
+		const SDCard::DirectoryEntry *entry = SDCard::fileAtIndex(i);
 		SimpleSerial::sendText("File: ");
-		SimpleSerial::sendText(entry->fileName);
+		SimpleSerial::sendText(SDCard::getFileName(entry));
 		SimpleSerial::sendText(" size: ");
 		SimpleSerial::sendWordHex(entry->fileSize);
 		SimpleSerial::sendText(" start: ");
 		SimpleSerial::sendWordHex(entry->startBlock);
 		SimpleSerial::sendNewline();
-		entry = entry->next;
 	}
+	SimpleSerial::sendText("Directory memory: ");
+	SimpleSerial::sendWordHex(SDCard::directoryMemoryUsed());
+	SimpleSerial::sendText(" of ");
+	SimpleSerial::sendWordHex(SDCard::directoryMemorySize());
+	SimpleSerial::sendNewline();
 
 	// Calibrate the sensor
 	SimpleSerial::sendLine("Calibrate the sensor...");
@@ -150,6 +171,7 @@ void initialize()
 	SimpleSerial::sendLine("Ready!");
 
 	// Start detecting a movement.
+	prepareNextSound();
 	Detector::start();
 	_state = Detecting;
 }
@@ -160,6 +182,9 @@ void main()
 	// The endless main loop.
 	for (;;) {
 		switch (_state) {
+		case Initialize:
+			// initialize() always leaves this state before the main loop.
+			break;
 		case Error:
 			errorMode();
 			break;
@@ -200,6 +225,11 @@ bool checkForCommand()
 				break;
 			}
 		}
+		// Commands which change the mode stop a playing sound first.
+		if (AudioPlayer::isPlaying() && command != CmdInfo && command != CmdHelp && command != CmdStat && command != CmdNext && command != CmdUnknown) {
+			AudioPlayer::stop();
+			endSound();
+		}
 		switch (command) {
 		case CmdMain:
 			if (_state == Detecting) {
@@ -235,13 +265,20 @@ bool checkForCommand()
 			break;
 		case CmdPlay:
 			if (_state == Maintenance) {
+				_soundStartTime = SimpleTimer::ticks();
 				TimedInterrupt::stop();
-				SimpleSerial::sendLine("Sound started.");
-				playSound();
-				SimpleSerial::sendLine("Sound finished.");
-				TimedInterrupt::setCallback(&onBlinkInterrupt);
-				TimedInterrupt::setFrequency(TimedInterrupt::Frequency_05Hz);
-				TimedInterrupt::start();
+				if (!startNextSound("Sound started.")) {
+					endSound();
+				}
+			} else {
+				SimpleSerial::sendLine("Only available in maintenance mode.");
+			}
+			break;
+		case CmdNext:
+			if (_state == Maintenance && AudioPlayer::isPlaying()) {
+				queueNextSound();
+			} else if (_state == Maintenance) {
+				SimpleSerial::sendLine("No sound is playing.");
 			} else {
 				SimpleSerial::sendLine("Only available in maintenance mode.");
 			}
@@ -252,6 +289,8 @@ bool checkForCommand()
 				SimpleSerial::sendLine("Calibration started.");
 				Detector::calibrate();
 				SimpleSerial::sendLine("Calibration finished.");
+				TimedInterrupt::setCallback(&onBlinkInterrupt);
+				TimedInterrupt::setFrequency(TimedInterrupt::Frequency_05Hz);
 				TimedInterrupt::start();
 			} else {
 				SimpleSerial::sendLine("Only available in maintenance mode.");
@@ -279,6 +318,9 @@ bool checkForCommand()
 			SimpleSerial::sendNewline();
 			break;
 		}
+		case CmdStat:
+			sendStatistics();
+			break;
 		case CmdUnknown:
 		default:
 			SimpleSerial::sendText("Unknown command: ");
@@ -304,13 +346,11 @@ void detectingMode()
 	}
 	// Check if the sensor detects something.
 	if (Detector::isAlarm()) {
+		_soundStartTime = SimpleTimer::ticks();
 		Detector::stop();
 		_state = PlayingSound;
-	} else {
-		// Reset the alarm count if for a while none is detected.
-		if (++_alarmResetCount > 50) {
-			_alarmCount = 0;
-			_alarmResetCount = 0;
+		if (!startNextSound("Alarm!")) {
+			endSound();
 		}
 	}
 }
@@ -320,19 +360,14 @@ void detectingMode()
 ///
 void playingSoundMode()
 {
-	SimpleSerial::sendLine("Alarm!");
-	playSound();
-	// Count the subsequent alarms, re-calibrate if there are 3 subsequent alarms.
-	++_alarmCount;
-	_alarmResetCount = 0;
-	if (_alarmCount >= 3) {
-		_alarmCount = 0;
-		SimpleSerial::sendLine("Sensor Recalibration...");
-		Detector::calibrate();
+	// Refill the sample buffer and check for commands while the sound is playing.
+	if (!AudioPlayer::poll()) {
+		endSound();
+		return;
 	}
-	// Go back to detecting mode.
-	Detector::start();
-	_state = Detecting;
+	checkForCommand();
+	// Sleep until the next refill to save power.
+	AudioPlayer::sleepUntilRefill();
 }
 
 
@@ -353,8 +388,19 @@ void beginMaintenance()
 ///
 void maintenanceMode()
 {
-	// Just wait for another command.
-	checkForCommand();
+	// Refill the sample buffer if a sound is playing.
+	if (AudioPlayer::isPlaying()) {
+		if (AudioPlayer::poll()) {
+			checkForCommand();
+			AudioPlayer::sleepUntilRefill();
+			return;
+		}
+		endSound();
+	}
+	// Wait for another command.
+	if (!checkForCommand()) {
+		PE_NOP();
+	}
 }
 
 
@@ -367,6 +413,7 @@ void endMaintenance()
 	SimpleSerial::sendLine("Calibrate the sensor...");
 	Detector::calibrate();
 	SimpleSerial::sendLine("Ready!");
+	prepareNextSound();
 	Detector::start();
 	_state = Detecting;
 }
@@ -394,9 +441,9 @@ void errorMode()
 }
 
 
-/// Play the next sound from the SD card.
+/// Get the next sound file from the SD card.
 ///
-void playSound()
+const SDCard::DirectoryEntry* nextSoundFile()
 {
 	// Read the current sound file from the file directory.
 	const SDCard::DirectoryEntry *file = SDCard::fileAtIndex(_nextPlayedFileIndex);
@@ -405,9 +452,111 @@ void playSound()
 		file = SDCard::fileAtIndex(_nextPlayedFileIndex);
 	}
 	++_nextPlayedFileIndex;
-	// Play the sound file.
-	SimpleSerial::sendLine(file->fileName);
-	AudioPlayer::playSound(file->startBlock, file->fileSize);
+	return file;
+}
+
+
+/// Prepare the next sound, if this is enabled.
+///
+void prepareNextSound()
+{
+#if LR_APPLICATION_PREPARE_SOUND
+	if (AudioPlayer::preparedFile() == nullptr) {
+		AudioPlayer::prepare(nextSoundFile());
+	}
+#endif
+}
+
+
+/// Start playing the next sound from the SD card.
+///
+/// The message and the file name are sent after the sound has started, so
+/// they do not delay the first sample.
+///
+/// @param message The message to send before the file name.
+/// @return true if the sound was started, false on an error.
+///
+bool startNextSound(const char *message)
+{
+	// Play the prepared sound or the next sound file.
+	const SDCard::DirectoryEntry *file = AudioPlayer::preparedFile();
+	if (file == nullptr) {
+		file = nextSoundFile();
+	}
+	const bool isStarted = AudioPlayer::start(file);
+	SimpleSerial::sendLine(message);
+	SimpleSerial::sendLine(SDCard::getFileName(file));
+	return isStarted;
+}
+
+
+/// Add the next sound from the SD card to the playlist.
+///
+void queueNextSound()
+{
+	const SDCard::DirectoryEntry *file = nextSoundFile();
+	if (AudioPlayer::enqueue(file)) {
+		SimpleSerial::sendText("Sound queued: ");
+		SimpleSerial::sendLine(SDCard::getFileName(file));
+	} else {
+		SimpleSerial::sendLine("Playlist is full.");
+	}
+}
+
+
+/// Continue in the current mode after a sound has finished.
+///
+void endSound()
+{
+	if (_state == PlayingSound) {
+		// Go back to detecting mode, the detector follows the ambient light itself.
+		prepareNextSound();
+		Detector::start();
+		_state = Detecting;
+	} else {
+		// Continue with the maintenance mode.
+		SimpleSerial::sendLine("Sound finished.");
+		TimedInterrupt::setCallback(&onBlinkInterrupt);
+		TimedInterrupt::setFrequency(TimedInterrupt::Frequency_05Hz);
+		TimedInterrupt::start();
+	}
+}
+
+
+/// Send one value of the playback statistics.
+///
+void sendStatistic(const char *text, uint16_t value)
+{
+	SimpleSerial::sendText(text);
+	SimpleSerial::sendWordHex(value);
+	SimpleSerial::sendNewline();
+}
+
+
+/// Convert timer ticks into microseconds, limited to 16bit.
+///
+uint16_t ticksToMicroseconds(uint32_t ticks)
+{
+	const uint32_t microseconds = ticks / SimpleTimer::cTicksPerMicrosecond;
+	return (microseconds > 0xffff) ? 0xffff : static_cast<uint16_t>(microseconds);
+}
+
+
+/// Send the playback statistics of the last sound.
+///
+/// A copy is printed, as a playing sound keeps updating the statistics. The
+/// sample buffer is refilled by the mode loop after the command.
+///
+void sendStatistics()
+{
+	const AudioPlayer::Statistics statistics = AudioPlayer::statistics();
+	sendStatistic("Underruns: ", statistics.underrunCount);
+	sendStatistic("Minimum fill: ", statistics.minimumFill);
+	sendStatistic("Maximum read (us): ", ticksToMicroseconds(statistics.maximumReadTicks));
+	sendStatistic("Blocks: ", statistics.blockCount);
+	// The time from the alarm or play command until the first sample was played.
+	sendStatistic("Start latency (us): ", ticksToMicroseconds(statistics.firstSampleTime - _soundStartTime));
+	sendStatistic("Read retries: ", statistics.retryCount);
 }
 
 
@@ -466,6 +615,8 @@ void endSensorDump()
 {
 	SimpleSerial::sendLine("Sensor dump stopped.");
 	_state = Maintenance;
+	TimedInterrupt::setCallback(&onBlinkInterrupt);
+	TimedInterrupt::setFrequency(TimedInterrupt::Frequency_05Hz);
 	TimedInterrupt::start();
 }
 
@@ -526,3 +677,8 @@ void onBlinkInterrupt()
 
 }
 }
+
+
+// The audio player handles the timer interrupt while a sound is playing, the
+// detector and blink callbacks are called from the timer module otherwise.
+LR_BIND_TIMED_INTERRUPT(lr::AudioPlayer::onTimedInterrupt)
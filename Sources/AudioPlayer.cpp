@@ -6,15 +6,25 @@
 #include "AudioPlayer.h"
 
 
+#include "ImaAdpcm.h"
+#include "RingBuffer.h"
 #include "SDCard.h"
 #include "SimpleIO.h"
 #include "SimpleSerial.h"
 #include "SimpleTimer.h"
 #include "TimedInterrupt.h"
+#include "TimedInterruptHandler.h"
 
 #include <Cpu.h>
 
 
+/// Set this to 1 to measure the latency from the timer overflow to the DAC write.
+///
+#ifndef LR_AUDIO_MEASURE_LATENCY
+#define LR_AUDIO_MEASURE_LATENCY 0
+#endif
+
+
 namespace lr {
 namespace AudioPlayer {
 
@@ -24,59 +34,250 @@ namespace AudioPlayer {
 ///
 const uint16_t _bufferSize = 0x100;
 
-/// The mask for the sample buffer size.
-/// This mask is used to keep the sample buffer index in the correct range.
+/// The sample buffer.
+/// Filled in the main loop and emptied in the timer interrupt.
 ///
-const uint16_t _bufferSizeMask = 0xff;
+RingBuffer<uint8_t, _bufferSize> _buffer;
 
-/// The sample buffer.
+/// The fill level of the sample buffer which wakes up the main loop for a refill.
+/// The rest of the buffer has to bridge the delay between two blocks on the SD card.
 ///
-uint8_t _buffer[_bufferSize];
+const uint16_t _lowWaterMark = _bufferSize / 2;
 
-/// The read index in the sample buffer.
+/// The fill level at which the interrupt requests a refill.
+/// This is the low water mark while reading and zero while the buffer is drained.
 ///
-volatile uint16_t _readIndex = 0;
+volatile uint16_t _refillLevel = 0;
 
-/// The write index in the sample buffer.
+/// The flag set by the interrupt if the buffer reached the refill level.
 ///
-volatile uint16_t _writeIndex = 0;
+volatile bool _isRefillRequested = false;
 
 /// The counter to count the played samples.
 ///
 volatile uint32_t _sampleCounter = 0;
 
 /// The current size of the played sound.
-/// This is used to stop the played sound at the end.
+/// This is used to stop the played sound at the end. For a playlist, this is
+/// the end of the last sound which was opened for reading.
 ///
 volatile uint32_t _playedSoundSize = 0;
 
-/// The number of bytes which are read in one step.
+/// The number of samples written into the sample buffer.
+///
+uint32_t _writtenSampleCount;
+
+/// The number of samples which are read in one step.
 ///
 const uint16_t _readBlockSize = 32;
 
+/// The number of bytes which are read in one step for packed samples.
+///
+const uint16_t _packedReadBlockSize = _readBlockSize / 4 * 3;
+
+/// A sound to play, a whole file or a segment of a sound bank.
+///
+struct Sound {
+	const SDCard::DirectoryEntry *file; ///< The file with the samples.
+	uint32_t offset; ///< The offset of the samples in the file in bytes.
+	uint32_t size; ///< The size of the samples in bytes.
+};
+
+/// The maximum number of sounds waiting in the playlist.
+///
+const uint8_t _playlistSize = cMaximumSequenceLength - 1;
+
+/// The sounds which are played after the current one.
+///
+RingBuffer<Sound, _playlistSize> _playlist;
+
+/// The state of the playback.
+///
+enum PlayState : uint8_t {
+	PlayState_Idle, ///< No sound is playing.
+	PlayState_Reading, ///< The sound file is read into the sample buffer.
+	PlayState_Draining, ///< The file was read, the rest of the sample buffer is played.
+};
+
+/// The current state of the playback.
+///
+PlayState _playState = PlayState_Idle;
+
+/// The file of the played or prepared sound.
+///
+const SDCard::DirectoryEntry *_file = nullptr;
+
+/// The flag if the sound is prepared, but the interrupt is not started yet.
+///
+bool _isPrepared = false;
+
+/// The size of the played sound in bytes.
+///
+uint32_t _soundSize;
+
+/// The number of bytes read from the played sound.
+///
+uint32_t _readCounter;
+
+/// The block and retry counters of the SD card at the start of the sound.
+///
+uint16_t _startBlockCount;
+uint16_t _startRetryCount;
+
+/// The codec of the played file.
+///
+SDCard::Codec _codec;
+
+/// The state of the IMA ADPCM decoder.
+///
+ImaAdpcm::State _adpcmState;
+
+/// The statistics of the current sound.
+///
+Statistics _statistics;
+
+/// The number of sample interrupts with an empty sample buffer.
+/// This counter is kept separate, because it is changed in the interrupt.
+///
+volatile uint16_t _underrunCount;
+
+/// Flag if the time of the first played sample is not recorded yet.
+///
+volatile bool _isFirstSamplePending = false;
+
+/// The SimpleTimer::ticks() when the first sample was played.
+///
+volatile uint32_t _firstSampleTime;
+
+/// The sample format handled in the timer interrupt.
+///
+enum InterruptMode : uint8_t {
+	InterruptMode_Off, ///< No sound is playing, the timer callback handles the interrupt.
+	InterruptMode_Unsigned8, ///< Play unsigned 8bit samples.
+	InterruptMode_Level6, ///< Play 6bit DAC values.
+};
+
+/// The current interrupt mode.
+///
+volatile InterruptMode _interruptMode = InterruptMode_Off;
+
+#if LR_AUDIO_MEASURE_LATENCY
+/// The latency from the timer overflow to the DAC write in timer ticks.
+///
+uint16_t _minimumLatency;
+uint16_t _maximumLatency;
+uint32_t _totalLatency;
+uint32_t _latencyCount;
+#endif
+
+
+/// Write an unsigned 8bit sample to the DAC.
+///
+inline void writeUnsigned8(uint8_t sample)
+{
+	SimpleIO::setAudioLevel(sample >> 2);
+}
 
-/// This interrupt is called at 44.1kHz to play the samples.
+
+/// Write a pre-quantized 6bit sample to the DAC.
 ///
-void interrupt()
+inline void writeLevel6(uint8_t sample)
+{
+	SimpleIO::setAudioLevel(sample);
+}
+
+
+/// Unpack samples with 6bit, four samples are packed into three bytes.
+///
+/// The first sample is in the lower bits of the first byte.
+///
+/// @param packed The packed samples.
+/// @param samples The buffer for the unpacked samples.
+/// @param groupCount The number of groups with four samples.
+///
+inline void unpackSamples(const uint8_t *packed, uint8_t *samples, uint8_t groupCount)
+{
+	for (uint8_t i = 0; i < groupCount; ++i) {
+		const uint8_t byte0 = packed[0];
+		const uint8_t byte1 = packed[1];
+		const uint8_t byte2 = packed[2];
+		samples[0] = byte0 & 0x3f;
+		samples[1] = (byte0 >> 6) | ((byte1 & 0x0f) << 2);
+		samples[2] = (byte1 >> 4) | ((byte2 & 0x03) << 4);
+		samples[3] = byte2 >> 2;
+		packed += 3;
+		samples += 4;
+	}
+}
+
+
+/// Record the latency of the DAC write.
+///
+inline void measureLatency()
+{
+#if LR_AUDIO_MEASURE_LATENCY
+	const uint16_t latency = TimedInterrupt::ticksSinceOverflow();
+	if (latency < _minimumLatency) {
+		_minimumLatency = latency;
+	}
+	if (latency > _maximumLatency) {
+		_maximumLatency = latency;
+	}
+	_totalLatency += latency;
+	++_latencyCount;
+#endif
+}
+
+
+/// This interrupt is called at the sample rate of the file to play the samples.
+///
+/// There is one version for each sample format, selected in onTimedInterrupt().
+///
+template<void (*writeSample)(uint8_t)>
+inline void interrupt()
 {
 	// Check if there are samples in the buffer.
-	if (_readIndex != _writeIndex) {
+	uint8_t sample;
+	if (_buffer.pop(sample)) {
 
 		// Check if we are in the range of the played sound.
 		if (_sampleCounter < _playedSoundSize) {
-			// Read the sample and adjust the DAC output.
-			const uint8_t sample = _buffer[_readIndex];
-			SimpleIO::setAudioValue(sample >> 2);
+			// Adjust the DAC output.
+			writeSample(sample);
+			measureLatency();
+			if (_isFirstSamplePending) {
+				_firstSampleTime = SimpleTimer::ticks();
+				_isFirstSamplePending = false;
+			}
 		} else {
-			SimpleIO::setAudioValue(0x7f >> 2);
+			SimpleIO::setAudioLevel(0x7f >> 2);
 		}
 
-		// Increase the read index.
-		++_readIndex;
-		_readIndex &= _bufferSizeMask;
-
 		// Increase the sample counter.
 		++_sampleCounter;
+
+		// Wake up the main loop if the buffer needs a refill.
+		if (_buffer.size() <= _refillLevel) {
+			_isRefillRequested = true;
+		}
+	} else if (_sampleCounter > 0 && _sampleCounter < _playedSoundSize) {
+		// The buffer ran dry after the start and before the end of the sound.
+		++_underrunCount;
+	}
+}
+
+
+bool onTimedInterrupt()
+{
+	switch (_interruptMode) {
+	case InterruptMode_Level6:
+		interrupt<writeLevel6>();
+		return true;
+	case InterruptMode_Unsigned8:
+		interrupt<writeUnsigned8>();
+		return true;
+	default:
+		return false;
 	}
 }
 
@@ -87,82 +288,468 @@ void initialize()
 }
 
 
-void playSound(const uint32_t startBlock, const uint32_t size)
+/// Release the SD card after reading the sound file.
+///
+/// @param stopRead true to stop the multi block read first.
+///
+void endReading(bool stopRead)
 {
-	// Enable the audio driver.
-	SimpleIO::setAudioEnabled(true);
+	if (stopRead) {
+		SDCard::stopRead();
+	}
+	SDCard::endTransaction();
+	_refillLevel = 0;
+	_playState = PlayState_Draining;
+}
 
-	// Variables.
-	uint32_t readCounter = 0;
-	uint16_t readByteCount;
+
+/// Report an error of the SD card.
+///
+/// @param message The message to send before the error code.
+///
+void sendError(const char *message)
+{
+	SimpleSerial::sendText(message);
+	SimpleSerial::sendCharacter('A'+SDCard::error());
+	SimpleSerial::sendNewline();
+}
+
+
+/// Report a read error and release the SD card.
+///
+/// The rest of the playlist is dropped.
+///
+/// @param message The message to send before the error code.
+///
+void endReadingWithError(const char *message)
+{
+	sendError(message);
+	endReading(false);
+	_playlist.reset();
+}
+
+
+/// Copy the counters of the played sound into the statistics.
+///
+void updateStatistics()
+{
+	_statistics.underrunCount = _underrunCount;
+	_statistics.firstSampleTime = _firstSampleTime;
+	_statistics.blockCount = SDCard::blockCount() - _startBlockCount;
+	_statistics.retryCount = SDCard::retryCount() - _startRetryCount;
+}
+
+
+/// Stop the interrupt and the audio driver.
+///
+void endPlayback()
+{
+	// Stop the interrupts
+	TimedInterrupt::stop();
+	_interruptMode = InterruptMode_Off;
+
+	// Disable the audio driver.
+	SimpleIO::setAudioEnabled(false);
+	updateStatistics();
+	_playState = PlayState_Idle;
+
+#if LR_AUDIO_MEASURE_LATENCY
+	// Report the latency in core cycles, the timer runs with the bus clock (half the core clock).
+	if (_latencyCount > 0) {
+		SimpleSerial::sendText("DAC write latency (cycles) min: ");
+		SimpleSerial::sendWordHex(_minimumLatency * 2);
+		SimpleSerial::sendText(" avg: ");
+		SimpleSerial::sendWordHex(static_cast<uint16_t>(_totalLatency * 2 / _latencyCount));
+		SimpleSerial::sendText(" max: ");
+		SimpleSerial::sendWordHex(_maximumLatency * 2);
+		SimpleSerial::sendNewline();
+	}
+#endif
+}
+
+
+/// Set the sound which is read into the sample buffer.
+///
+/// The samples of the sound are added after the samples already written into the buffer.
+///
+/// @param sound The sound to read.
+///
+void setSound(const Sound &sound)
+{
+	_file = sound.file;
+	_soundSize = sound.size;
+	_codec = sound.file->codec;
+	_readCounter = 0;
+	ImaAdpcm::reset(_adpcmState);
+	switch (_codec) {
+	case SDCard::Codec_Packed6:
+		_playedSoundSize = _writtenSampleCount + _soundSize / 3 * 4;
+		break;
+	case SDCard::Codec_ImaAdpcm4:
+		_playedSoundSize = _writtenSampleCount + _soundSize * 2;
+		break;
+	default:
+		_playedSoundSize = _writtenSampleCount + _soundSize;
+		break;
+	}
+}
+
+
+/// Continue reading with the next sound of the playlist.
+///
+/// Only a sound with the same codec and sample rate can follow without a gap,
+/// because the interrupt keeps running. If the sound starts shortly after the
+/// current one, like the next file on the card or the next segment of a sound
+/// bank, the multi block read continues. Otherwise the read is restarted at
+/// the new sound. The sample buffer is not drained in both cases.
+///
+/// @return true if the next sound is read, false if there is no such sound or on an error.
+///
+bool continueWithNextSound()
+{
+	if (_playlist.isEmpty()) {
+		return false;
+	}
+	const Sound &sound = _playlist.peek(0);
+	if (sound.file->codec != _codec || sound.file->sampleRate != _file->sampleRate) {
+		// Play the sound after the current one has finished.
+		return false;
+	}
+	if (SDCard::seek(sound.file->startBlock, sound.offset) == SDCard::StatusError) {
+		endReadingWithError("Error start reading: ");
+		return false;
+	}
+	setSound(sound);
+	_playlist.commitRead(1);
+	return true;
+}
+
+
+/// Read one step of samples into the sample buffer.
+///
+/// A step ends at the next multiple of the step size in the sample buffer or
+/// at the end of the sound. After a sound which ended in the middle of a step,
+/// the next step is shorter, so the free space is contiguous again.
+///
+/// @return true if the samples were read, false if there is no space in the buffer or on an error.
+///
+bool readStep()
+{
+	// The buffer size is a multiple of the step size, so the free space of one step is always contiguous.
+	uint16_t sampleCount = _readBlockSize - static_cast<uint16_t>(_writtenSampleCount % _readBlockSize);
+	const uint32_t remainingSampleCount = _playedSoundSize - _writtenSampleCount;
+	if (remainingSampleCount < sampleCount) {
+		sampleCount = static_cast<uint16_t>(remainingSampleCount);
+	}
+	uint16_t spanLength;
+	uint8_t * const samples = _buffer.writeSpan(spanLength);
+	if (spanLength < sampleCount) {
+		return false;
+	}
+
+	// Read a block of data, encoded samples are decoded into the buffer.
+	uint8_t encodedBuffer[_packedReadBlockSize];
+	uint16_t byteCount;
+	if (_codec == SDCard::Codec_Packed6) {
+		byteCount = sampleCount / 4 * 3;
+	} else if (_codec == SDCard::Codec_ImaAdpcm4) {
+		byteCount = sampleCount / 2;
+	} else {
+		byteCount = sampleCount;
+	}
+	uint16_t readByteCount = byteCount;
+	SDCard::Status status;
+	const uint32_t readStartTime = SimpleTimer::ticks();
+	if (_codec == SDCard::Codec_Packed6 || _codec == SDCard::Codec_ImaAdpcm4) {
+		status = SDCard::readData(encodedBuffer, &readByteCount);
+	} else {
+		status = SDCard::readData(samples, &readByteCount);
+	}
+	const uint32_t readTicks = SimpleTimer::ticks() - readStartTime;
+	if (readTicks > _statistics.maximumReadTicks) {
+		_statistics.maximumReadTicks = readTicks;
+	}
+	if (status == SDCard::StatusError || readByteCount != byteCount) {
+		endReadingWithError("Error while reading: ");
+		return false;
+	}
+	if (_codec == SDCard::Codec_Packed6) {
+		unpackSamples(encodedBuffer, samples, sampleCount / 4);
+	} else if (_codec == SDCard::Codec_ImaAdpcm4) {
+		ImaAdpcm::decode(_adpcmState, encodedBuffer, samples, byteCount);
+	}
+
+	// The fill level is the lowest just before new samples are added.
+	// The first buffer is filled from empty at the start and is ignored.
+	const uint16_t fill = _buffer.size();
+	if (_sampleCounter >= _bufferSize && fill < _statistics.minimumFill) {
+		_statistics.minimumFill = fill;
+	}
+
+	// Pass the samples to the interrupt.
+	_buffer.commitWrite(sampleCount);
+	_writtenSampleCount += sampleCount;
+
+	// Increase the total read counter.
+	_readCounter += readByteCount;
+	if (_writtenSampleCount >= _playedSoundSize) {
+		// Continue with the next sound of the playlist, or end reading.
+		if (!continueWithNextSound() && _playState == PlayState_Reading) {
+			endReading(true);
+		}
+	}
+	return true;
+}
+
+
+/// Open a sound and start reading it.
+///
+/// @param sound The sound to read.
+/// @return true on success, false on an error.
+///
+bool openSound(const Sound &sound)
+{
+	// Refuse to play a file with an unknown codec.
+	if (sound.file->codec > SDCard::Codec_ImaAdpcm4) {
+		SimpleSerial::sendLine("Unknown codec.");
+		_playlist.reset();
+		return false;
+	}
 
 	// Reset the variables for the interrupt routine.
-	_readIndex = 0;
-	_writeIndex = 0;
+	_buffer.reset();
 	_sampleCounter = 0;
-	_playedSoundSize = size;
+	_writtenSampleCount = 0;
+	_startBlockCount = SDCard::blockCount();
+	_startRetryCount = SDCard::retryCount();
+	_refillLevel = _lowWaterMark;
+	_isRefillRequested = true;
+	setSound(sound);
+
+	// Start reading from the SD card, keep the card selected until the end.
+	SDCard::beginTransaction();
+	_playState = PlayState_Reading;
+	if (SDCard::seek(sound.file->startBlock, sound.offset) == SDCard::StatusError) {
+		endReadingWithError("Error start reading: ");
+		_playState = PlayState_Idle;
+		return false;
+	}
+	return true;
+}
+
+
+/// Open a sound file and start reading it.
+///
+/// For a sound bank, the segments are read from the segment table. The first
+/// segment is opened, the following ones are added to the playlist.
+///
+/// @param file The directory entry of the sound file or sound bank.
+/// @param segments The indexes of the segments, or nullptr for the first segments of a sound bank.
+/// @param count The number of segments, at most cMaximumSequenceLength.
+/// @return true on success, false on an error.
+///
+bool openFile(const SDCard::DirectoryEntry *file, const uint8_t *segments, uint8_t count)
+{
+	Sound sound = {file, 0, file->fileSize};
+	if (file->type == SDCard::FileType_SoundBank || segments != nullptr) {
+		SDCard::Segment tableSegments[cMaximumSequenceLength];
+		if (SDCard::readSegments(file, segments, &count, tableSegments) == SDCard::StatusError) {
+			sendError("Error reading segments: ");
+			return false;
+		}
+		for (uint8_t i = 1; i < count; ++i) {
+			const Sound nextSound = {file, tableSegments[i].offset, tableSegments[i].size};
+			_playlist.push(nextSound);
+		}
+		sound.offset = tableSegments[0].offset;
+		sound.size = tableSegments[0].size;
+	}
+	return openSound(sound);
+}
+
+
+/// Start the interrupt to play the opened sound.
+///
+void startPlayback()
+{
+	// Reset the statistics.
+	_statistics.minimumFill = _bufferSize;
+	_statistics.maximumReadTicks = 0;
+	_underrunCount = 0;
+
+#if LR_AUDIO_MEASURE_LATENCY
+	_minimumLatency = 0xffff;
+	_maximumLatency = 0;
+	_totalLatency = 0;
+	_latencyCount = 0;
+#endif
 
-	// Start the interrupt
-	TimedInterrupt::setCallback(&interrupt);
-	TimedInterrupt::setFrequency(TimedInterrupt::Frequency_44100Hz);
+	// Enable the audio driver.
+	SimpleIO::setAudioEnabled(true);
+
+	// Start the interrupt, all codecs except the unsigned samples are decoded to DAC values.
+	if (_codec == SDCard::Codec_Unsigned8) {
+		_interruptMode = InterruptMode_Unsigned8;
+	} else {
+		_interruptMode = InterruptMode_Level6;
+	}
+	TimedInterrupt::setFrequency(static_cast<uint32_t>(_file->sampleRate));
 	TimedInterrupt::start();
 
-	// Start reading from the SD card.
-	SDCard::Status status = SDCard::startMultiRead(startBlock);
-	if (status == SDCard::StatusError) {
-		SimpleSerial::sendText("Error start reading: ");
-		SimpleSerial::sendCharacter('A'+SDCard::error());
-		SimpleSerial::sendNewline();
-		goto lStopRead;
+	// Fill the buffer, a prepared buffer is already full.
+	poll();
+}
+
+
+bool prepare(const SDCard::DirectoryEntry *file)
+{
+	// Stop a previous sound.
+	stop();
+
+	if (!openFile(file, nullptr, cMaximumSequenceLength)) {
+		return false;
 	}
 
-	// The read loop
-	while (readCounter < size) {
+	// Fill the whole buffer, the interrupt is not running yet.
+	while (_playState == PlayState_Reading) {
+		if (!readStep()) {
+			break;
+		}
+	}
+	_isPrepared = true;
+	return true;
+}
+
+
+const SDCard::DirectoryEntry* preparedFile()
+{
+	return (_isPrepared ? _file : nullptr);
+}
 
-		// Read the current buffer size and make sure there is no interrupt
-		EnterCritical();
-		const uint16_t bytesInBuffer = ((_writeIndex - _readIndex) & _bufferSizeMask);
-		ExitCritical();
 
-		// As soon there is empty space in the buffer, read additional samples.
-		if (bytesInBuffer <= (_bufferSize-(_readBlockSize*2))) {
+bool start(const SDCard::DirectoryEntry *file)
+{
+	if (!_isPrepared || file != _file) {
+		// Stop a previous sound.
+		stop();
+		if (!openFile(file, nullptr, cMaximumSequenceLength)) {
+			return false;
+		}
+	}
+	_isPrepared = false;
+	_isFirstSamplePending = true;
+	startPlayback();
+	return true;
+}
 
-			// Read a block of data.
-			readByteCount = _readBlockSize;
-			status = SDCard::readData((_buffer + _writeIndex), &readByteCount);
-			if (status == SDCard::StatusError || readByteCount != _readBlockSize) {
-				SimpleSerial::sendText("Error while reading: ");
-				SimpleSerial::sendCharacter('A'+SDCard::error());
-				SimpleSerial::sendNewline();
-				goto lStopRead;
-			}
 
-			// Increase the write index, make sure there is no interrupt.
-			EnterCritical();
-			_writeIndex += readByteCount;
-			_writeIndex &= _bufferSizeMask;
-			ExitCritical();
+bool startSegments(const SDCard::DirectoryEntry *bank, const uint8_t *segments, uint8_t count)
+{
+	// Stop a previous sound.
+	stop();
+	if (count == 0 || count > cMaximumSequenceLength || !openFile(bank, segments, count)) {
+		return false;
+	}
+	_isFirstSamplePending = true;
+	startPlayback();
+	return true;
+}
 
-			// Increase the total read counter.
-			readCounter += readByteCount;
+
+bool enqueue(const SDCard::DirectoryEntry *file)
+{
+	if (!isPlaying()) {
+		return start(file);
+	}
+	if (file->type == SDCard::FileType_SoundBank) {
+		return false;
+	}
+	const Sound sound = {file, 0, file->fileSize};
+	return _playlist.push(sound);
+}
+
+
+bool poll()
+{
+	switch (_playState) {
+	case PlayState_Reading:
+		// Fill all free space in the buffer.
+		_isRefillRequested = false;
+		while (_playState == PlayState_Reading) {
+			if (!readStep()) {
+				break;
+			}
 		}
+		return true;
+	case PlayState_Draining:
+		// Wait until the last audio was played.
+		if (!_buffer.isEmpty()) {
+			_isRefillRequested = false;
+			return true;
+		}
+		endPlayback();
+		// Start the next sound of the playlist, which could not follow without a gap.
+		if (!_playlist.isEmpty()) {
+			const Sound sound = _playlist.peek(0);
+			_playlist.commitRead(1);
+			if (openSound(sound)) {
+				startPlayback();
+				return true;
+			}
+		}
+		return false;
+	default:
+		return false;
+	}
+}
+
 
+void stop()
+{
+	_playlist.reset();
+	if (_isPrepared) {
+		// The interrupt was not started yet, only release the SD card.
+		if (_playState == PlayState_Reading) {
+			endReading(true);
+		}
+		_isPrepared = false;
+		_playState = PlayState_Idle;
+		return;
 	}
+	if (_playState == PlayState_Reading) {
+		endReading(true);
+	}
+	if (_playState == PlayState_Draining) {
+		endPlayback();
+	}
+}
 
-	// Stop reading from the SD card.
-	SDCard::stopRead();
 
-	// Wait until the last audio was played.
-	while (_readIndex != _writeIndex) PE_NOP();
+bool isPlaying()
+{
+	return _playState != PlayState_Idle && !_isPrepared;
+}
 
-lStopRead:
-	// Stop the interrupts
-	TimedInterrupt::stop();
 
-	// Disable the audio driver.
-	SimpleIO::setAudioEnabled(false);
+const Statistics& statistics()
+{
+	// Keep the statistics of the last sound while the next one is prepared.
+	if (isPlaying()) {
+		updateStatistics();
+	}
+	return _statistics;
+}
+
+
+void sleepUntilRefill()
+{
+	// Each sample interrupt wakes up the core, sleep again until the refill is requested.
+	while (isPlaying() && !_isRefillRequested) {
+		PE_WFI();
+	}
 }
 
 
 }
 }
+
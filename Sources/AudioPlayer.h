@@ -6,6 +6,8 @@
 //
 
 
+#include "SDCard.h"
+
 #include <cinttypes>
 
 
@@ -13,16 +15,127 @@ namespace lr {
 namespace AudioPlayer {
 
 
+/// The maximum number of sounds in a sequence, the played one and the playlist.
+///
+const uint8_t cMaximumSequenceLength = 5;
+
+
+/// Statistics about the playback of the last sound.
+///
+struct Statistics {
+	uint16_t underrunCount; ///< The number of sample interrupts with an empty sample buffer.
+	uint16_t minimumFill; ///< The lowest fill level of the sample buffer while reading the file.
+	uint32_t maximumReadTicks; ///< The longest SD card read of one step, in SimpleTimer::ticks().
+	uint16_t blockCount; ///< The number of blocks read from the SD card.
+	uint32_t firstSampleTime; ///< The SimpleTimer::ticks() when the first sample after start() was played.
+	uint16_t retryCount; ///< The number of attempts to resume the read after a SD card error.
+};
+
+
 /// Initialize the audio player.
 ///
 void initialize();
 
+/// Prepare a sound file to start it without delay.
+///
+/// Starts reading the file and fills the sample buffer, but does not start
+/// the interrupt. The SD card stays selected until the sound is started
+/// or stopped. A previous sound is stopped. A sound bank is prepared as
+/// in start().
+///
+/// @param file The directory entry of the sound file.
+/// @return true if the sound was prepared, false on an error.
+///
+bool prepare(const SDCard::DirectoryEntry *file);
+
+/// Get the prepared sound file.
+///
+/// @return The prepared file, or nullptr if no sound is prepared.
+///
+const SDCard::DirectoryEntry* preparedFile();
+
 /// Start playing a sound file.
 ///
-/// @param startBlock The first block of the sound file on the SD card.
-/// @param size The size of the sound file in bytes.
+/// The samples are decoded as set in the codec of the directory entry.
+/// For a sound bank, the first segments are played in order, up to
+/// cMaximumSequenceLength segments.
+/// If the file was prepared, the first samples are played immediately.
+/// This call returns after the first refill, call poll() from the main loop
+/// until it returns false. A previous sound and the playlist are stopped.
+///
+/// @param file The directory entry of the sound file.
+/// @return true if the sound was started, false on an error.
+///
+bool start(const SDCard::DirectoryEntry *file);
+
+/// Start playing a sequence of segments from a sound bank.
+///
+/// The positions of all segments are read from the segment table first.
+/// The segments are played without gaps, like files in the playlist. A
+/// previous sound and the playlist are stopped.
+///
+/// @param bank The directory entry of the sound bank.
+/// @param segments The indexes of the segments to play.
+/// @param count The number of segments, at most cMaximumSequenceLength.
+/// @return true if the sound was started, false on an error.
+///
+bool startSegments(const SDCard::DirectoryEntry *bank, const uint8_t *segments, uint8_t count);
+
+/// Add a sound file to the playlist.
+///
+/// The file is played after the current sound and the files already in the
+/// playlist. It follows without a gap if it has the same codec and sample rate
+/// and the reading of the previous file has not ended yet. Otherwise it starts
+/// after the previous file has finished. If no sound is playing, the file is
+/// started immediately.
+///
+/// The segment table can not be read while a sound is playing, so a sound
+/// bank can only be added if no sound is playing.
+///
+/// @param file The directory entry of the sound file.
+/// @return true if the file was added, false if the playlist is full or on an error.
+///
+bool enqueue(const SDCard::DirectoryEntry *file);
+
+/// Refill the sample buffer of the played sound.
+///
+/// Reads the free space of the sample buffer from the SD card and returns.
+/// Call this often enough to keep the sample buffer filled, at 44.1kHz the
+/// buffer lasts for about 5ms.
+///
+/// @return true while the sound is playing, false if it and the playlist have finished.
+///
+bool poll();
+
+/// Stop the played sound immediately and clear the playlist.
+///
+void stop();
+
+/// Check if a sound is playing.
+///
+/// @return true if a sound is playing.
+///
+bool isPlaying();
+
+/// Sleep until the sample buffer needs a refill.
+///
+/// The interrupt requests a refill if the buffer drops to the low water mark,
+/// or when the last sample was played. Returns immediately if no sound is
+/// playing. Serial input is handled after the next refill.
+///
+void sleepUntilRefill();
+
+/// Get the statistics of the last or current sound.
+///
+/// @return The statistics, reset at the start of each sound.
+///
+const Statistics& statistics();
+
+/// The handler which is bound to the timer interrupt.
+///
+/// @return true if a sound is playing and the interrupt was handled.
 ///
-void playSound(const uint32_t startBlock, const uint32_t size);
+bool onTimedInterrupt();
 
 
 }
@@ -9,6 +9,7 @@
 #include "SimpleADC.h"
 #include "SimpleIO.h"
 #include "SimpleSerial.h"
+#include "SimpleTimer.h"
 #include "TimedInterrupt.h"
 
 #include <Cpu.h>
@@ -46,6 +47,38 @@ const uint16_t _minimumSignalThreshold = 8;
 ///
 const uint16_t _maximumSignalThreshold = 950;
 
+/// The number of measurements for the calibration.
+///
+const uint8_t _calibrationMeasurements = 32;
+
+/// The threshold is this multiple of the standard deviation above the baseline.
+///
+const uint8_t _thresholdSigmaMultiple = 4;
+
+/// The extra safety which is added to the threshold.
+///
+const uint16_t _thresholdMargin = 5;
+
+/// The number of fractional bits of the tracked baseline.
+///
+const uint8_t _baselineFractionBits = 8;
+
+/// The weight of a new measurement in the tracked baseline and variance, as shift (1/32).
+///
+const uint8_t _trackingShift = 5;
+
+/// The tracked baseline (mean) of the normalized difference without a signal.
+///
+/// Fixed point value with _baselineFractionBits fractional bits.
+///
+uint32_t _baseline = 0;
+
+/// The tracked variance of the normalized difference without a signal.
+///
+/// Fixed point value with 8 fractional bits, so the square root has 4.
+///
+uint32_t _variance = 0;
+
 /// The absolute signal maximum value.
 ///
 const uint16_t _signalAbsoluteMaximum = 0xfff; // 12bit
@@ -54,9 +87,112 @@ const uint16_t _signalAbsoluteMaximum = 0xfff; // 12bit
 ///
 const uint16_t _signalNormalizedMaximum = 1000;
 
+/// The delay from switching the LED until this can be detected, in microseconds.
+///
+const uint32_t _lightDelay = 100;
+
+/// The time slot for the conversions of one triggered batch, in microseconds.
+///
+/// One batch of 8 conversions takes ~195us with the ADC clock and sample time
+/// set in SimpleADC::initialize(), the slot adds a margin for the interrupt.
+/// If the conversions take longer, reading the batch waits for them.
+///
+const uint32_t _conversionSlot = 250;
+
+/// The number of samples in one triggered batch.
+///
+const uint8_t _batchSize = SimpleADC::cMaximumBatchSize;
+
+/// The pause between two signal intervals, in microseconds.
+///
+const uint32_t _intervalPause = 10000;
+
+/// The period of one measurement, in microseconds.
+///
+const uint32_t _measurementPeriod = 200000;
+
+/// The time for the sampling of one measurement, without the pauses.
+///
+/// One conversion slot to discard the batch which was sampled with the
+/// indicator and one light delay, then three conversion slots and two light
+/// delays for each signal interval.
+///
+const uint32_t _measurementSampleTime = _conversionSlot + _lightDelay +
+	_signalIntervals * (3 * _conversionSlot + 2 * _lightDelay);
+
+/// The pause after the last signal interval, until the next measurement starts.
+///
+const uint32_t _measurementPause = _measurementPeriod - _measurementSampleTime -
+	(_signalIntervals - 1) * _intervalPause;
+
+/// The timer configurations for the delays between the phases.
+///
+constexpr TimedInterrupt::Configuration _lightDelayConfiguration = TimedInterrupt::configurationForPeriod(_lightDelay);
+constexpr TimedInterrupt::Configuration _conversionSlotConfiguration = TimedInterrupt::configurationForPeriod(_conversionSlot);
+constexpr TimedInterrupt::Configuration _intervalPauseConfiguration = TimedInterrupt::configurationForPeriod(_intervalPause);
+constexpr TimedInterrupt::Configuration _measurementPauseConfiguration = TimedInterrupt::configurationForPeriod(_measurementPause);
+
+/// The phase of the timer driven measurement.
+///
+/// Each overflow of the timer triggers a batch of conversions in the ADC and
+/// runs one phase in the interrupt. The phases alternate: After the light
+/// delay, the overflow starts the conversions and the interrupt sets the
+/// conversion slot. At the end of the slot, the trigger is masked because
+/// the results are not read yet. This interrupt reads the results, switches
+/// the signal and sets the light delay. So the time between switching the
+/// signal and sampling is set by the timer.
+///
+enum Phase : uint8_t {
+	Phase_Start, ///< Turn off the signal, the triggered batch is discarded.
+	Phase_Discard, ///< Discard the batch, the next trigger samples the level with the signal off.
+	Phase_SampleOff, ///< The level with the signal off is sampled.
+	Phase_SignalOn, ///< Read the level with the signal off, then raise the signal.
+	Phase_SampleOn, ///< The level with the signal on is sampled.
+	Phase_SignalOff, ///< Read the level with the signal on, then lower the signal.
+	Phase_SampleAfter, ///< The level after the signal is sampled.
+	Phase_Complete, ///< Read the level after the signal, then pause.
+};
+
+/// The phase for the next timer interrupt.
+///
+Phase _phase = Phase_Start;
+
+/// The number of signal intervals of the current measurement.
+///
+uint8_t _intervalCount;
+
+/// The number of completed signal intervals of the current measurement.
+///
+uint8_t _completedIntervals;
+
+/// The last sampled sensor value.
+///
+uint16_t _lastValue;
+
+/// The sum of the differences between the signal off and on levels.
+///
+uint32_t _signalDifference;
+
+/// The sum of the levels with the signal off.
+///
+uint32_t _signalMinimum;
+
+/// The array for the sample pairs of the current measurement, or nullptr.
+///
+SamplePair *_samplePairs = nullptr;
+
+/// Flag if the timer stops after the current measurement.
+///
+bool _isSingleMeasurement = false;
+
+/// Flag which is set if a single measurement is complete.
+///
+volatile bool _isMeasurementComplete = false;
+
 
 // Forward declarations.
 void onInterrupt();
+void startMeasurements(uint8_t intervalCount, const TimedInterrupt::Configuration &startDelay);
 
 
 
@@ -70,15 +206,15 @@ void start()
 {
 	_positiveSignals = 0;
 	_negativeSignals = 0;
-	TimedInterrupt::setCallback(&Detector::onInterrupt);
-	TimedInterrupt::setFrequency(TimedInterrupt::Frequency_5Hz);
-	TimedInterrupt::start();
+	_isSingleMeasurement = false;
+	startMeasurements(_signalIntervals, _measurementPauseConfiguration);
 }
 
 
 void stop()
 {
 	TimedInterrupt::stop();
+	SimpleADC::stopTriggeredBatches();
 }
 
 
@@ -88,23 +224,14 @@ bool isAlarm()
 }
 
 
-/// Wait for the delay from switching on/off the LED, until this can be detected.
-///
-void waitLightDelay()
-{
-	// The delay has to be around 100 microseconds.
-	for (uint16_t i = 0; i < 0x300; ++i) PE_NOP();
-}
-
-
 uint16_t getAverageSensorValue()
 {
-	const uint8_t sampleCount = 16;
-	const uint16_t delayBetweenSamples = 0x4;
+	// The samples are converted in batches using the hardware FIFO.
+	const uint8_t batchCount = 2;
+	const uint8_t sampleCount = batchCount * SimpleADC::cMaximumBatchSize;
 	uint32_t average = 0;
-	for (uint8_t i = 0; i < sampleCount; ++i) {
-		average += SimpleADC::getSample();
-		for (uint16_t i = 0; i < delayBetweenSamples; ++i) PE_NOP();
+	for (uint8_t i = 0; i < batchCount; ++i) {
+		average += SimpleADC::getSampleSum(SimpleADC::cMaximumBatchSize);
 	}
 	average /= sampleCount;
 	return (uint16_t)average;
@@ -123,98 +250,266 @@ inline uint16_t absoluteDifference(uint16_t a, uint16_t b)
 }
 
 
-void checkForSignal(uint16_t &normalizedDifference, uint16_t &signalHeadRoom)
+/// Read the average value of the last triggered batch.
+///
+inline uint16_t readBatchAverage()
 {
-	// Start by turning off the signal.
+	return SimpleADC::readBatchSum() / _batchSize;
+}
+
+
+/// Reset the values for a new measurement.
+///
+void beginMeasurement(uint8_t intervalCount)
+{
+	_intervalCount = intervalCount;
+	_completedIntervals = 0;
+	_signalDifference = 0;
+	_signalMinimum = 0;
+}
+
+
+/// Read the level with the signal off, then raise the signal.
+///
+void readSignalOff()
+{
+	_lastValue = readBatchAverage();
+	_signalMinimum += _lastValue;
+	SimpleIO::setSignal(true);
+}
+
+
+/// Read the level with the signal on, then lower the signal.
+///
+void readSignalOn()
+{
+	const uint16_t value = readBatchAverage();
 	SimpleIO::setSignal(false);
-	uint16_t value1 = 0;
-	uint16_t value2 = 0;
-	uint32_t signalDifference = 0;
-	uint32_t signalMinimum = 0;
-	// Now send some signals and check if we get a response.
-	for (uint8_t i = 0; i < _signalIntervals; ++i) {
-		// Wait for the components to settle.
-		waitLightDelay();
-		// Sample the current level.
-		value1 = getAverageSensorValue();
-		signalMinimum += value1;
-		// Raise the signal.
-		SimpleIO::setSignal(true);
-		// Wait until we can expect a response from the IR transistor.
-		waitLightDelay();
-		// Measure the difference.
-		value2 = getAverageSensorValue();
-		signalDifference += absoluteDifference(value1, value2);
-		// Lower the signal.
-		SimpleIO::setSignal(false);
-		// Wait for the components to settle.
-		waitLightDelay();
-		// Measure the difference.
-		signalDifference += absoluteDifference(value2, getAverageSensorValue());
-		// Make a longer pause before starting the new measurement.
-		for (uint8_t j = 0; j < 100; ++j) {
-			waitLightDelay();
-		}
+	if (_samplePairs != nullptr) {
+		_samplePairs[_completedIntervals] = SamplePair{_lastValue, value};
 	}
+	_signalDifference += absoluteDifference(_lastValue, value);
+	_lastValue = value;
+}
+
+
+/// Read the level after the signal and complete the interval.
+///
+void readAfterSignal()
+{
+	_signalDifference += absoluteDifference(_lastValue, readBatchAverage());
+	++_completedIntervals;
+}
+
+
+/// Calculate the result of the measurement.
+///
+void endMeasurement(uint16_t &normalizedDifference, uint16_t &signalHeadRoom)
+{
 	// Calculate the averages for this measurement.
-	signalDifference /= (_signalIntervals*2);
-	signalMinimum /= _signalIntervals;
+	const uint32_t signalDifference = _signalDifference / (_intervalCount*2);
+	const uint32_t signalMinimum = _signalMinimum / _intervalCount;
 	// Normalize the values.
 	signalHeadRoom = (_signalAbsoluteMaximum - signalMinimum);
 	normalizedDifference = (signalDifference * _signalNormalizedMaximum) / signalHeadRoom;
 }
 
 
+/// Start the timer and the triggered conversions for the measurements.
+///
+/// @param intervalCount The number of signal intervals of the first measurement.
+/// @param startDelay The delay until the first measurement starts.
+///
+void startMeasurements(uint8_t intervalCount, const TimedInterrupt::Configuration &startDelay)
+{
+	beginMeasurement(intervalCount);
+	_phase = Phase_Start;
+	SimpleADC::startTriggeredBatches(_batchSize);
+	TimedInterrupt::setCallback(&Detector::onInterrupt);
+	TimedInterrupt::setConfiguration(startDelay);
+	TimedInterrupt::start();
+}
+
+
+/// Run a single measurement with the timer and wait until it is complete.
+///
+/// @param intervalCount The number of signal intervals.
+/// @param pairs An array for the sample pairs, or nullptr.
+///
+void runSingleMeasurement(uint8_t intervalCount, SamplePair *pairs)
+{
+	TimedInterrupt::stop();
+	_isSingleMeasurement = true;
+	_isMeasurementComplete = false;
+	_samplePairs = pairs;
+	startMeasurements(intervalCount, _lightDelayConfiguration);
+	while (!_isMeasurementComplete) {
+		PE_WFI();
+	}
+	SimpleADC::stopTriggeredBatches();
+	_samplePairs = nullptr;
+	_isSingleMeasurement = false;
+}
+
+
+void checkForSignal(uint16_t &normalizedDifference, uint16_t &signalHeadRoom)
+{
+	runSingleMeasurement(_signalIntervals, nullptr);
+	endMeasurement(normalizedDifference, signalHeadRoom);
+}
+
+
+void measureSamplePairs(SamplePair *pairs, uint8_t count)
+{
+	if (count == 0) {
+		return;
+	}
+	runSingleMeasurement(count, pairs);
+}
+
+
+/// Calculate the square root of a value, rounded up.
+///
+uint16_t squareRootRoundedUp(uint32_t value)
+{
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+	while (bit > value) {
+		bit >>= 2;
+	}
+	while (bit != 0) {
+		if (value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	// The remaining value is the difference to the square of the root.
+	if (value > 0) {
+		++root;
+	}
+	return (uint16_t)root;
+}
+
+
+/// Set the threshold from the tracked baseline and variance.
+///
+void updateThreshold()
+{
+	// Calculate with 4 fractional bits, the resolution of the standard deviation.
+	const uint32_t deviation = squareRootRoundedUp(_variance);
+	const uint32_t baseline = _baseline >> (_baselineFractionBits - 4);
+	uint32_t threshold = ((baseline + _thresholdSigmaMultiple * deviation + 0xf) >> 4) + _thresholdMargin;
+	if (threshold < _minimumSignalThreshold) {
+		threshold = _minimumSignalThreshold;
+	} else if (threshold > _maximumSignalThreshold) {
+		threshold = _maximumSignalThreshold;
+	}
+	_signalThreshold = (uint16_t)threshold;
+}
+
+
+/// Update the baseline and the variance with a measurement without a signal.
+///
+/// Both values are exponentially weighted moving averages, so the threshold
+/// follows a slow drift of the ambient light.
+///
+void trackMeasurement(uint16_t normalizedDifference)
+{
+	const uint32_t value = (uint32_t)normalizedDifference << _baselineFractionBits;
+	uint32_t difference;
+	if (value >= _baseline) {
+		difference = value - _baseline;
+		_baseline += difference >> _trackingShift;
+	} else {
+		difference = _baseline - value;
+		_baseline -= difference >> _trackingShift;
+	}
+	// Square the difference with 4 fractional bits, to get 8 fractional bits.
+	difference >>= (_baselineFractionBits - 4);
+	const uint32_t square = difference * difference;
+	if (square >= _variance) {
+		_variance += (square - _variance) >> _trackingShift;
+	} else {
+		_variance -= (_variance - square) >> _trackingShift;
+	}
+	updateThreshold();
+}
+
+
 bool calibrate()
 {
-	// Measure the current difference
+	const uint32_t startTime = SimpleTimer::elapsedTimeMS();
+	// Collect the sum and the sum of squares from a series of measurements.
 	uint16_t normalizedDifference;
 	uint16_t signalHeadRoom;
-	checkForSignal(normalizedDifference, signalHeadRoom);
-	// Start with this average value
-	_signalThreshold = normalizedDifference;
-	// Increase the threshold slightly for each test.
-	for (bool signalDetected = true; signalDetected; _signalThreshold += 5) {
-		if (_signalThreshold >= _maximumSignalThreshold) {
+	uint32_t sum = 0;
+	uint32_t squareSum = 0;
+	for (uint8_t i = 0; i < _calibrationMeasurements; ++i) {
+		checkForSignal(normalizedDifference, signalHeadRoom);
+		if (normalizedDifference >= _maximumSignalThreshold) {
 			// Failed to calibrate the sensor, unable to filter the signal.
 			return false;
 		}
-		// Make a longer test with this threshold settings.
-		signalDetected = false;
-		for (uint8_t i = 0; i < 32; ++i) {
-			checkForSignal(normalizedDifference, signalHeadRoom);
-			if (normalizedDifference >= _signalThreshold) {
-				signalDetected = true;
-				break;
-			}
-		}
+		sum += normalizedDifference;
+		squareSum += (uint32_t)normalizedDifference * normalizedDifference;
 	}
-	// Add some extra safety.
-	_signalThreshold += 5;
+	// Calculate the mean and the standard deviation: sqrt(n*sum(x^2) - sum(x)^2) / n
+	const uint16_t mean = (sum + _calibrationMeasurements/2) / _calibrationMeasurements;
+	const uint16_t deviation = (squareRootRoundedUp(_calibrationMeasurements * squareSum - sum * sum) +
+		_calibrationMeasurements - 1) / _calibrationMeasurements;
+	// Start the tracking with these values, and set the threshold above the noise.
+	_baseline = (sum << _baselineFractionBits) / _calibrationMeasurements;
+	_variance = ((uint32_t)deviation * deviation) << 8;
+	updateThreshold();
+	if (_signalThreshold >= _maximumSignalThreshold) {
+		return false;
+	}
+	const uint32_t duration = SimpleTimer::elapsedTimeMS() - startTime;
 	// Write the new sensor threshold to the serial line.
 	SimpleSerial::sendText("St: ");
 	SimpleSerial::sendWordHex(_signalThreshold);
 	SimpleSerial::sendText(" Shr: ");
 	SimpleSerial::sendWordHex(signalHeadRoom);
+	SimpleSerial::sendText(" Sm: ");
+	SimpleSerial::sendWordHex(mean);
+	SimpleSerial::sendText(" Ssd: ");
+	SimpleSerial::sendWordHex(deviation);
+	SimpleSerial::sendNewline();
+	SimpleSerial::sendText("Calibration time (ms): ");
+	SimpleSerial::sendWordHex((uint16_t)duration);
 	SimpleSerial::sendNewline();
 	return true;
 }
 
 
-/// The method which is called in each interrupt.
+/// Set the phase and the delay for the next timer interrupt.
 ///
-void onInterrupt()
+inline void scheduleNextPhase(Phase phase, const TimedInterrupt::Configuration &configuration)
+{
+	_phase = phase;
+	TimedInterrupt::stop();
+	TimedInterrupt::setConfiguration(configuration);
+	TimedInterrupt::start();
+}
+
+
+/// Evaluate a completed measurement.
+///
+void evaluateMeasurement()
 {
-	// Get some sensor input.
 	uint16_t normalizedDifference;
 	uint16_t signalHeadRoom;
-	checkForSignal(normalizedDifference, signalHeadRoom);
+	endMeasurement(normalizedDifference, signalHeadRoom);
 	// Check if the signal exceeds the threshold.
 	if (normalizedDifference >= _signalThreshold) {
 		++_positiveSignals; // Count the positive signals.
 		_negativeSignals = 0;
 		SimpleIO::setSignal(true);
 	} else {
+		trackMeasurement(normalizedDifference);
 		++_negativeSignals; // Count the negative signals.
 		if (_negativeSignals >= 2) {
 			_positiveSignals = 0;
@@ -224,6 +519,66 @@ void onInterrupt()
 }
 
 
+/// Complete a measurement after the last signal interval.
+///
+void completeMeasurement()
+{
+	if (_isSingleMeasurement) {
+		TimedInterrupt::stop();
+		_isMeasurementComplete = true;
+	} else {
+		evaluateMeasurement();
+		beginMeasurement(_signalIntervals);
+		scheduleNextPhase(Phase_Start, _measurementPauseConfiguration);
+	}
+}
+
+
+/// The method which is called in each interrupt.
+///
+/// Runs one phase of the measurement. The sampling is triggered by the
+/// timer overflow in hardware, the interrupt sets the delay until the
+/// next phase.
+///
+void onInterrupt()
+{
+	switch (_phase) {
+	case Phase_Start:
+		SimpleIO::setSignal(false);
+		scheduleNextPhase(Phase_Discard, _conversionSlotConfiguration);
+		break;
+	case Phase_Discard:
+		SimpleADC::readBatchSum();
+		scheduleNextPhase(Phase_SampleOff, _lightDelayConfiguration);
+		break;
+	case Phase_SampleOff:
+		scheduleNextPhase(Phase_SignalOn, _conversionSlotConfiguration);
+		break;
+	case Phase_SignalOn:
+		readSignalOff();
+		scheduleNextPhase(Phase_SampleOn, _lightDelayConfiguration);
+		break;
+	case Phase_SampleOn:
+		scheduleNextPhase(Phase_SignalOff, _conversionSlotConfiguration);
+		break;
+	case Phase_SignalOff:
+		readSignalOn();
+		scheduleNextPhase(Phase_SampleAfter, _lightDelayConfiguration);
+		break;
+	case Phase_SampleAfter:
+		scheduleNextPhase(Phase_Complete, _conversionSlotConfiguration);
+		break;
+	case Phase_Complete:
+		readAfterSignal();
+		if (_completedIntervals < _intervalCount) {
+			scheduleNextPhase(Phase_SampleOff, _intervalPauseConfiguration);
+		} else {
+			completeMeasurement();
+		}
+		break;
+	}
+}
+
 
 }
 }
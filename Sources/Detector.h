@@ -13,18 +13,33 @@ namespace lr {
 namespace Detector {
 
 
+/// A matched pair of sensor values from one signal interval.
+///
+struct SamplePair {
+	uint16_t off; ///< The average sensor value (12bit) with the signal off.
+	uint16_t on; ///< The average sensor value (12bit) with the signal on.
+};
+
+
 /// Initialize the detector.
 ///
 void initialize();
 
 /// Calibrate the detector.
 ///
+/// Makes a fixed number of measurements and sets the threshold from the
+/// mean and the standard deviation of the measured differences. The
+/// measurements use the timed interrupt, it is stopped afterwards.
+///
 /// @return true on success, false if the sensor can not be calibrated.
 ///
 bool calibrate();
 
 /// Start the detector.
 ///
+/// Each measurement without a signal updates the tracked baseline and noise
+/// of the sensor, so the threshold follows a slow drift of the ambient light.
+///
 void start();
 
 /// Stop the detector
@@ -39,11 +54,26 @@ uint16_t getAverageSensorValue();
 
 /// Check manually for a signal.
 ///
+/// Runs a single measurement with the timed interrupt, which is stopped
+/// afterwards.
+///
 /// @param normalizedDifference Output variable to get the normalized difference.
 /// @param signalHeadRoom Output variable to get the signal head room.
 ///
 void checkForSignal(uint16_t &normalizedDifference, uint16_t &signalHeadRoom);
 
+/// Measure matched pairs of sensor values (blocking).
+///
+/// Each pair is sampled in one signal interval, with the same timing as the
+/// detection. The conversions are triggered by the timer which also switches
+/// the signal, so the delay between the signal and the samples is fixed.
+/// The detector has to be stopped.
+///
+/// @param pairs The array for the pairs.
+/// @param count The number of pairs to measure, nothing is measured if this is zero.
+///
+void measureSamplePairs(SamplePair *pairs, uint8_t count);
+
 /// Check if there is an alarm.
 ///
 /// @return true if there is an alarm, false if there is none.
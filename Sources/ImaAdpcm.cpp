@@ -0,0 +1,97 @@
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+#include "ImaAdpcm.h"
+
+
+namespace lr {
+namespace ImaAdpcm {
+
+
+/// The step sizes of the IMA ADPCM codec.
+///
+const int16_t cStepSizes[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+	253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+	3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+	12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/// The change of the step index for the lower three bits of a sample.
+///
+const int8_t cStepIndexChanges[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+/// The highest step index.
+///
+const uint8_t cMaximumStepIndex = 88;
+
+
+/// Decode a single sample.
+///
+/// @param state The state of the decoder.
+/// @param nibble The 4bit sample.
+/// @return The 6bit DAC value.
+///
+inline uint8_t decodeSample(State &state, uint8_t nibble)
+{
+	const int32_t step = cStepSizes[state.stepIndex];
+	int32_t difference = step >> 3;
+	if ((nibble & 4) != 0) {
+		difference += step;
+	}
+	if ((nibble & 2) != 0) {
+		difference += step >> 1;
+	}
+	if ((nibble & 1) != 0) {
+		difference += step >> 2;
+	}
+	int32_t predictor = state.predictor;
+	if ((nibble & 8) != 0) {
+		predictor -= difference;
+		if (predictor < -32768) {
+			predictor = -32768;
+		}
+	} else {
+		predictor += difference;
+		if (predictor > 32767) {
+			predictor = 32767;
+		}
+	}
+	state.predictor = static_cast<int16_t>(predictor);
+	int8_t stepIndex = static_cast<int8_t>(state.stepIndex) + cStepIndexChanges[nibble & 7];
+	if (stepIndex < 0) {
+		stepIndex = 0;
+	} else if (stepIndex > cMaximumStepIndex) {
+		stepIndex = cMaximumStepIndex;
+	}
+	state.stepIndex = static_cast<uint8_t>(stepIndex);
+	// Convert the signed 16bit sample into the 6bit DAC value.
+	return static_cast<uint8_t>((predictor + 32768) >> 10);
+}
+
+
+void reset(State &state)
+{
+	state.predictor = 0;
+	state.stepIndex = 0;
+}
+
+
+void decode(State &state, const uint8_t *data, uint8_t *levels, uint16_t byteCount)
+{
+	State localState = state;
+	for (uint16_t i = 0; i < byteCount; ++i) {
+		const uint8_t byte = data[i];
+		*levels++ = decodeSample(localState, byte & 0x0f);
+		*levels++ = decodeSample(localState, byte >> 4);
+	}
+	state = localState;
+}
+
+
+}
+}
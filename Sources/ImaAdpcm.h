@@ -0,0 +1,46 @@
+#pragma once
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+
+
+#include <cinttypes>
+
+
+namespace lr {
+namespace ImaAdpcm {
+
+
+/// The state of the decoder.
+///
+struct State {
+	int16_t predictor; ///< The last decoded 16bit sample.
+	uint8_t stepIndex; ///< The index into the step size table.
+};
+
+
+/// Reset the state for the start of a file.
+///
+/// The encoder starts with the same state, so the stream needs no header.
+///
+/// @param state The state to reset.
+///
+void reset(State &state);
+
+/// Decode 4bit IMA ADPCM samples into 6bit DAC values.
+///
+/// Each byte contains two samples, the first sample in the lower nibble.
+/// This call is used in the main loop, never in an interrupt.
+///
+/// @param state The state of the decoder, updated after the call.
+/// @param data The encoded bytes.
+/// @param levels The buffer for the 6bit DAC values, twice the size of the data.
+/// @param byteCount The number of encoded bytes.
+///
+void decode(State &state, const uint8_t *data, uint8_t *levels, uint16_t byteCount);
+
+
+}
+}
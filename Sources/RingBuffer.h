@@ -0,0 +1,201 @@
+#pragma once
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+
+
+#include <cinttypes>
+
+
+namespace lr {
+
+
+/// A lock-free ring buffer for one producer and one consumer.
+///
+/// One side of the buffer is used in an interrupt, the other one in the main
+/// loop. The producer only writes the write index and the consumer only the
+/// read index. Both indexes are free running 16bit values, which are read and
+/// written in a single access on the Cortex-M0+. Therefore no critical
+/// sections are required and the buffer can hold all N elements.
+///
+/// The bulk functions give access to a contiguous span of the buffer, so
+/// a driver can read data directly into the buffer without copying it.
+///
+/// @tparam T The element type.
+/// @tparam N The number of elements, a power of two.
+///
+template<typename T, uint16_t N>
+class RingBuffer
+{
+	static_assert(N > 0 && (N & (N - 1)) == 0, "The size of the ring buffer has to be a power of two.");
+	static_assert(N <= 0x8000, "The size of the ring buffer has to fit the 16bit indexes.");
+
+public:
+	/// The mask to keep an index in the range of the buffer.
+	///
+	static const uint16_t cIndexMask = N - 1;
+
+public:
+	/// Create an empty ring buffer.
+	///
+	RingBuffer()
+		: _readIndex(0), _writeIndex(0)
+	{
+	}
+
+	/// Remove all elements.
+	///
+	/// This is only allowed while neither the producer nor the consumer is active.
+	///
+	inline void reset()
+	{
+		_readIndex = 0;
+		_writeIndex = 0;
+	}
+
+	/// Get the number of elements in the buffer.
+	///
+	/// For the consumer this is the minimum, for the producer the maximum of elements.
+	///
+	inline uint16_t size() const
+	{
+		return static_cast<uint16_t>(_writeIndex - _readIndex);
+	}
+
+	/// Get the number of free elements in the buffer.
+	///
+	inline uint16_t space() const
+	{
+		return static_cast<uint16_t>(N - size());
+	}
+
+	/// Check if the buffer is empty.
+	///
+	inline bool isEmpty() const
+	{
+		return _writeIndex == _readIndex;
+	}
+
+	/// Check if the buffer is full.
+	///
+	inline bool isFull() const
+	{
+		return size() == N;
+	}
+
+	/// Add an element to the buffer (producer).
+	///
+	/// @param element The element to add.
+	/// @return true if the element was added, false if the buffer is full.
+	///
+	inline bool push(const T &element)
+	{
+		const uint16_t writeIndex = _writeIndex;
+		if (static_cast<uint16_t>(writeIndex - _readIndex) == N) {
+			return false;
+		}
+		_data[writeIndex & cIndexMask] = element;
+		publish();
+		_writeIndex = writeIndex + 1;
+		return true;
+	}
+
+	/// Remove an element from the buffer (consumer).
+	///
+	/// @param element The variable for the removed element.
+	/// @return true if an element was removed, false if the buffer is empty.
+	///
+	inline bool pop(T &element)
+	{
+		const uint16_t readIndex = _readIndex;
+		if (readIndex == _writeIndex) {
+			return false;
+		}
+		element = _data[readIndex & cIndexMask];
+		publish();
+		_readIndex = readIndex + 1;
+		return true;
+	}
+
+	/// Access an element without removing it (consumer).
+	///
+	/// @param index The index relative to the oldest element, has to be less than size().
+	///
+	inline const T& peek(uint16_t index) const
+	{
+		return _data[(_readIndex + index) & cIndexMask];
+	}
+
+	/// Get the contiguous free span at the write position (producer).
+	///
+	/// Write the elements into the span and call commitWrite() to add them.
+	///
+	/// @param length The variable for the number of elements in the span.
+	/// @return The start of the span.
+	///
+	inline T* writeSpan(uint16_t &length)
+	{
+		const uint16_t position = _writeIndex & cIndexMask;
+		const uint16_t free = space();
+		const uint16_t toEnd = N - position;
+		length = (free < toEnd ? free : toEnd);
+		return _data + position;
+	}
+
+	/// Add the elements written into the span from writeSpan() (producer).
+	///
+	/// @param count The number of written elements, at most the span length.
+	///
+	inline void commitWrite(uint16_t count)
+	{
+		publish();
+		_writeIndex = _writeIndex + count;
+	}
+
+	/// Get the contiguous span of elements at the read position (consumer).
+	///
+	/// Read the elements from the span and call commitRead() to remove them.
+	///
+	/// @param length The variable for the number of elements in the span.
+	/// @return The start of the span.
+	///
+	inline const T* readSpan(uint16_t &length) const
+	{
+		const uint16_t position = _readIndex & cIndexMask;
+		const uint16_t used = size();
+		const uint16_t toEnd = N - position;
+		length = (used < toEnd ? used : toEnd);
+		return _data + position;
+	}
+
+	/// Remove the elements read from the span from readSpan() (consumer).
+	///
+	/// @param count The number of read elements, at most the span length.
+	///
+	inline void commitRead(uint16_t count)
+	{
+		publish();
+		_readIndex = _readIndex + count;
+	}
+
+private:
+	/// Make sure all element accesses are done before an index is changed.
+	///
+	/// There is only one core, so the compiler is the only one which could
+	/// reorder the accesses.
+	///
+	static inline void publish()
+	{
+		__asm__ volatile ("" ::: "memory");
+	}
+
+private:
+	T _data[N]; ///< The elements.
+	volatile uint16_t _readIndex; ///< The free running read index, only changed by the consumer.
+	volatile uint16_t _writeIndex; ///< The free running write index, only changed by the producer.
+};
+
+
+}
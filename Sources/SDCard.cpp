@@ -31,6 +31,19 @@ const uint16_t cInitTimeout = 2000;
 ///
 const uint16_t cBlockSize = 512;
 
+/// The timeout for the start of a data block in ms.
+///
+/// The specification limits the read access time to 100ms, the additional
+/// time covers slow cards. After a timeout the read is resumed.
+///
+const uint16_t cReadTimeout = 250;
+
+/// The number of attempts to resume a multi block read after an error.
+///
+/// The first attempt restarts the read, the following ones re-initialize the card first.
+///
+const uint8_t cResumeAttemptCount = 3;
+
 /// The SD Card type
 ///
 enum CardType : uint8_t {
@@ -78,6 +91,26 @@ enum ReadMode : uint8_t {
 	ReadModeMultipleBlocks = 1, ///< Read multiple blocks until stop is sent.
 };
 
+/// The size of a directory record in the version 2 format.
+///
+const uint16_t cRecordSizeV2 = 40;
+
+/// The offset of the name in a version 2 record.
+///
+const uint8_t cRecordNameOffsetV2 = 24;
+
+/// The size of the name field in a version 2 record.
+///
+const uint8_t cRecordNameSizeV2 = 16;
+
+/// The size of the sound bank header.
+///
+const uint8_t cSoundBankHeaderSize = 8;
+
+/// The size of a record in the segment table.
+///
+const uint8_t cSegmentRecordSize = 8;
+
 /// Responses and flags.
 ///
 const uint8_t cR1IdleState = 0x01; ///< The state if the card is idle.
@@ -102,17 +135,49 @@ CardType _cardType = CardTypeSD1;
 ///
 uint16_t _blockByteCount;
 
-/// The state of the read command.
+/// The block of the next byte of the running read.
+///
+uint32_t _readBlock;
+
+/// The number of data blocks received from the card.
+///
+uint16_t _blockCount = 0;
+
+/// The number of attempts to resume a read after an error.
 ///
-ReadState _blockReadState;
+uint16_t _retryCount = 0;
+
+/// The state of the read command, no read is running at the start.
+///
+ReadState _blockReadState = ReadStateEnd;
 
 /// The mode for the block read command.
 ///
 ReadMode _blockReadMode;
 
-/// The directory.
+/// The entries of the directory.
+///
+DirectoryEntry _directoryEntries[cMaximumFileCount];
+
+/// The number of entries in the directory.
+///
+uint8_t _directoryEntryCount = 0;
+
+/// The memory for the null terminated file names.
+///
+char _namePool[cNamePoolSize];
+
+/// The number of used bytes in the name pool.
+///
+uint16_t _namePoolUsed = 0;
+
+/// Flag if the directory entries are sorted by the name hash.
 ///
-DirectoryEntry *_directoryEntry = 0;
+bool _directorySorted = false;
+
+/// Flag if a transaction is active and the chip select is kept asserted.
+///
+bool _transactionActive = false;
 
 
 // Internal Functions
@@ -120,26 +185,32 @@ DirectoryEntry *_directoryEntry = 0;
 
 /// Chip select low
 ///
+/// In a transaction the line is already low.
+///
 inline void chipSelectBegin()
 {
-	SimpleIO::setSdCardCS(true);
+	if (!_transactionActive) {
+		SimpleIO::setSdCardCS(true);
+	}
 }
 
 
 /// Chip select high
 ///
+/// In a transaction the line is kept low until the transaction ends.
+///
 inline void chipSelectEnd()
 {
-	SimpleIO::setSdCardCS(false);
+	if (!_transactionActive) {
+		SimpleIO::setSdCardCS(false);
+	}
 }
 
 
 /// Skip a number of bytes from the SPI bus.
 ///
 inline void spiSkip(uint8_t count) {
-	for (uint8_t i = 0; i < count; ++i) {
-		SimpleSPI::receive();
-	}
+	SimpleSPI::skipBlock(count);
 }
 
 
@@ -170,11 +241,11 @@ bool waitUntilReady(uint16_t timeoutMillis) {
 /// Wait for the status byte.
 ///
 uint8_t waitForStatus(uint16_t timeoutMillis) {
-	SimpleTimer::reset();
+	const uint32_t startTime = SimpleTimer::elapsedTimeMS();
 	uint8_t result = SimpleSPI::receive();
 	while (result == 0xff) {
 		result = SimpleSPI::receive();
-		if (SimpleTimer::elapsedTimeMS() > timeoutMillis) {
+		if ((SimpleTimer::elapsedTimeMS() - startTime) > timeoutMillis) {
 			return cBlockDataTimeOut; // Time-out.
 		}
 	}
@@ -263,13 +334,353 @@ inline uint32_t getLittleEndianUInt32(const uint8_t *value) {
 }
 
 
+/// Read a little-endian 16bit integer from the given byte buffer.
+///
+/// @param value A pointer into the buffer where to read the integer.
+/// @return The read integer.
+///
+inline uint16_t getLittleEndianUInt16(const uint8_t *value) {
+	return static_cast<uint16_t>(value[0]) | (static_cast<uint16_t>(value[1]) << 8);
+}
+
+
+/// Add a new entry to the directory.
+///
+/// @param nameLength The space to reserve for the name, without the null terminator.
+/// @return The new entry with the name space in the pool, or nullptr if the directory is full.
+///
+DirectoryEntry* addDirectoryEntry(uint8_t nameLength)
+{
+	if (_directoryEntryCount >= cMaximumFileCount ||
+		(cNamePoolSize - _namePoolUsed) < (static_cast<uint16_t>(nameLength) + 1)) {
+		_error = Error_DirectoryFull;
+		return nullptr;
+	}
+	DirectoryEntry *entry = &_directoryEntries[_directoryEntryCount++];
+	entry->nameOffset = _namePoolUsed;
+	_namePool[_namePoolUsed + nameLength] = '\0';
+	_namePoolUsed += nameLength + 1;
+	entry->nameHash = 0;
+	entry->sampleRate = cDefaultSampleRate;
+	entry->codec = Codec_Unsigned8;
+	entry->type = FileType_Sound;
+	return entry;
+}
+
+
+/// Read the entries of a version 1 directory.
+///
+/// Each entry is a variable length record with the start block, the file size,
+/// the name length and the name. A start block of zero ends the directory.
+///
+/// @return StatusReady on success, StatusError on any error.
+///
+Status readDirectoryEntriesV1()
+{
+	uint8_t buffer[9];
+	uint16_t byteCount;
+	uint32_t startBlock;
+	uint32_t fileSize;
+	uint8_t stringLength;
+	do {
+		// Read the initial bytes.
+		byteCount = 9; // 2x 32bit integer + 1 byte string length.
+		if (readData(buffer, &byteCount) == StatusError) {
+			return StatusError;
+		}
+		// Interpret the bytes (not portable).
+		startBlock = getLittleEndianUInt32(buffer);
+		fileSize = getLittleEndianUInt32(buffer + 4);
+		stringLength = buffer[8];
+		if (startBlock > 0) {
+			DirectoryEntry *entry = addDirectoryEntry(stringLength);
+			if (entry == nullptr) {
+				return StatusError;
+			}
+			byteCount = stringLength;
+			char *fileName = _namePool + entry->nameOffset;
+			if (readData(reinterpret_cast<uint8_t*>(fileName), &byteCount) == StatusError) {
+				return StatusError;
+			}
+			entry->nameHash = nameHash(fileName);
+			entry->startBlock = startBlock;
+			entry->fileSize = fileSize;
+		}
+	} while(startBlock > 0);
+	// The entries are in the order of the image, not sorted by the name hash.
+	_directorySorted = false;
+	return StatusReady;
+}
+
+
+/// Read a fixed number of bytes from the directory block.
+///
+/// @param buffer The buffer for the data, or nullptr to skip the bytes.
+/// @param byteCount The number of bytes to read.
+/// @return StatusReady on success, StatusError on any error or a short read.
+///
+Status readDirectoryBytes(uint8_t *buffer, uint16_t byteCount)
+{
+	uint16_t readByteCount = byteCount;
+	if (readData(buffer, &readByteCount) == StatusError) {
+		return StatusError;
+	}
+	if (readByteCount < byteCount) {
+		_error = Error_ReadFailed;
+		return StatusError;
+	}
+	return StatusReady;
+}
+
+
+/// Read the entries of a version 2 directory.
+///
+/// After the magic follows the number of entries and the size of one record
+/// as 16bit values. The fixed size records are sorted by the name hash. A larger
+/// record size is accepted, the additional bytes are skipped. All records have
+/// to fit into block 0.
+///
+/// @return StatusReady on success, StatusError on any error.
+///
+Status readDirectoryEntriesV2()
+{
+	uint8_t buffer[cRecordSizeV2];
+	if (readDirectoryBytes(buffer, 4) == StatusError) {
+		return StatusError;
+	}
+	const uint16_t entryCount = getLittleEndianUInt16(buffer);
+	const uint16_t recordSize = getLittleEndianUInt16(buffer + 2);
+	if (recordSize < cRecordSizeV2 || recordSize > cBlockSize) {
+		_error = Error_UnknownMagic;
+		return StatusError;
+	}
+	if (entryCount > cMaximumFileCount) {
+		_error = Error_DirectoryFull;
+		return StatusError;
+	}
+	// The magic and the header use the first 8 bytes of the block.
+	if (static_cast<uint32_t>(entryCount) * recordSize > cBlockSize - 8) {
+		_error = Error_UnknownMagic;
+		return StatusError;
+	}
+	_directorySorted = true;
+	for (uint16_t i = 0; i < entryCount; ++i) {
+		if (readDirectoryBytes(buffer, cRecordSizeV2) == StatusError) {
+			return StatusError;
+		}
+		if (recordSize > cRecordSizeV2) {
+			if (readDirectoryBytes(nullptr, recordSize - cRecordSizeV2) == StatusError) {
+				return StatusError;
+			}
+		}
+		// Reject records which can not be played.
+		const uint16_t sampleRate = getLittleEndianUInt16(buffer + 12);
+		if (sampleRate == 0 || buffer[14] > Codec_ImaAdpcm4 || buffer[15] > FileType_SoundBank) {
+			_error = Error_InvalidDirectoryEntry;
+			return StatusError;
+		}
+		// The name is padded with null bytes, but not terminated if it uses the whole field.
+		const char *recordName = reinterpret_cast<const char*>(buffer + cRecordNameOffsetV2);
+		uint8_t nameLength = 0;
+		while (nameLength < cRecordNameSizeV2 && recordName[nameLength] != '\0') {
+			++nameLength;
+		}
+		DirectoryEntry *entry = addDirectoryEntry(nameLength);
+		if (entry == nullptr) {
+			return StatusError;
+		}
+		std::memcpy(_namePool + entry->nameOffset, recordName, nameLength);
+		entry->nameHash = getLittleEndianUInt32(buffer);
+		entry->startBlock = getLittleEndianUInt32(buffer + 4);
+		entry->fileSize = getLittleEndianUInt32(buffer + 8);
+		entry->sampleRate = sampleRate;
+		entry->codec = static_cast<Codec>(buffer[14]);
+		entry->type = static_cast<FileType>(buffer[15]);
+		if (i > 0 && entry[-1].nameHash > entry->nameHash) {
+			_directorySorted = false;
+		}
+	}
+	return StatusReady;
+}
+
+
+/// Read all entries of the directory.
+///
+/// @return StatusReady on success, StatusError on any error.
+///
+Status readDirectoryEntries()
+{
+	// Wait until the block 0 read command has started.
+	if (startRead(0) == StatusError) {
+		return StatusError;
+	}
+
+	// Read the magic.
+	uint8_t buffer[4];
+	uint16_t byteCount = 4;
+	if (readData(buffer, &byteCount) == StatusError) {
+		return StatusError;
+	}
+
+	// Check the magic and read the directory in the matching format.
+	_directoryEntryCount = 0;
+	_namePoolUsed = 0;
+	if (std::strncmp("HCDI", reinterpret_cast<char*>(buffer), 4) == 0) {
+		return readDirectoryEntriesV1();
+	} else if (std::strncmp("HCD2", reinterpret_cast<char*>(buffer), 4) == 0) {
+		return readDirectoryEntriesV2();
+	}
+	_error = Error_UnknownMagic;
+	return StatusError;
+}
+
+
+/// Read the records of the segment table.
+///
+/// Each record is reached with seek(), which skips forward in the running read
+/// and restarts the read for a record before the current position.
+///
+/// @return StatusReady on success, StatusError on any error.
+///
+Status readSegmentTable(const DirectoryEntry *bank, const uint8_t *indexes, uint8_t *count, Segment *segments)
+{
+	if (startMultiRead(bank->startBlock) == StatusError) {
+		return StatusError;
+	}
+
+	// Read and check the header.
+	uint8_t buffer[cSegmentRecordSize];
+	uint16_t byteCount = cSoundBankHeaderSize;
+	if (readData(buffer, &byteCount) == StatusError) {
+		return StatusError;
+	}
+	if (std::strncmp("HCSB", reinterpret_cast<char*>(buffer), 4) != 0) {
+		_error = Error_InvalidSoundBank;
+		return StatusError;
+	}
+	const uint16_t segmentCount = getLittleEndianUInt16(buffer + 4);
+	if (indexes == nullptr && *count > segmentCount) {
+		*count = static_cast<uint8_t>(segmentCount);
+	}
+	if (*count == 0) {
+		_error = Error_InvalidSoundBank;
+		return StatusError;
+	}
+
+	// Read the records.
+	for (uint8_t i = 0; i < *count; ++i) {
+		const uint16_t index = (indexes != nullptr ? indexes[i] : i);
+		if (index >= segmentCount) {
+			_error = Error_InvalidSoundBank;
+			return StatusError;
+		}
+		if (seek(bank->startBlock, cSoundBankHeaderSize + static_cast<uint32_t>(index) * cSegmentRecordSize) == StatusError) {
+			return StatusError;
+		}
+		byteCount = cSegmentRecordSize;
+		if (readData(buffer, &byteCount) == StatusError) {
+			return StatusError;
+		}
+		segments[i].offset = getLittleEndianUInt32(buffer);
+		segments[i].size = getLittleEndianUInt32(buffer + 4);
+		if (segments[i].offset > bank->fileSize || segments[i].size > bank->fileSize - segments[i].offset) {
+			_error = Error_InvalidSoundBank;
+			return StatusError;
+		}
+	}
+	return StatusReady;
+}
+
+
+/// Check if a multi block read is running.
+///
+inline bool isMultiReadRunning()
+{
+	return _blockReadMode == ReadModeMultipleBlocks && _blockReadState != ReadStateEnd;
+}
+
+
+/// Check if a read was started and is not ended yet.
+///
+inline bool isReadRunning()
+{
+	return _blockReadState != ReadStateEnd;
+}
+
+
+/// Wait for the start of a data block.
+///
+/// @return true if the data block starts, false on an error.
+///
+bool waitForDataBlock()
+{
+	const uint8_t result = waitForStatus(cReadTimeout);
+	if (result != cBlockDataStart) {
+		if (result == cBlockDataTimeOut) {
+			_error = Error_TimeOut;
+		} else {
+			_error = Error_ReadFailed;
+		}
+		return false;
+	}
+	++_blockCount;
+	return true;
+}
+
+
+/// Re-initialize the card in the middle of a read.
+///
+/// The initialization releases the chip select line. It is asserted again
+/// afterwards, because the caller continues to read from the card.
+///
+/// @return StatusReady on success, StatusError on any error.
+///
+Status reinitialize()
+{
+	const bool transactionActive = _transactionActive;
+	_transactionActive = false;
+	const Status status = initialize();
+	_transactionActive = transactionActive;
+	SimpleIO::setSdCardCS(true);
+	return status;
+}
+
+
+/// Resume the multi block read at the last good position after an error.
+///
+/// Errors are detected at the start of a block, so the read continues with
+/// this block. The first attempt stops and restarts the read. If this fails,
+/// the card is re-initialized before the next attempts.
+///
+/// @return StatusReady if the read continues, StatusError if all attempts failed.
+///
+Status resumeRead()
+{
+	const uint32_t block = _readBlock;
+	for (uint8_t attempt = 0; attempt < cResumeAttemptCount; ++attempt) {
+		++_retryCount;
+		if (attempt == 0) {
+			stopRead(); // The card may have aborted the read already.
+		} else if (reinitialize() == StatusError) {
+			continue;
+		}
+		if (startMultiRead(block) == StatusError || !waitForDataBlock()) {
+			continue;
+		}
+		_blockReadState = ReadStateReadData;
+		return StatusReady;
+	}
+	return StatusError;
+}
+
+
 // Interface Functions
 // -------------------
 
 Status initialize()
 {
-	// Reset the timer to detect timeout in initialization.
-	SimpleTimer::reset();
+	// Keep the start time to detect timeout in initialization.
+	const uint32_t startTime = SimpleTimer::elapsedTimeMS();
 
 	// Initialize some used variables.
 	uint32_t argument = 0;
@@ -291,7 +702,7 @@ Status initialize()
 	chipSelectBegin();
 	// Send the CMD0
 	while (waitAndSendCommand(Cmd_GoIdleState, 0) != cR1IdleState) {
-		if (SimpleTimer::elapsedTimeMS() > cInitTimeout) {
+		if ((SimpleTimer::elapsedTimeMS() - startTime) > cInitTimeout) {
 			_error = Error_TimeOut;
 			goto initFail;
 		}
@@ -316,7 +727,7 @@ Status initialize()
 		argument = 0x00000000;
 	}
 	while (waitAndSendCommand(ACmd_SendOpCond, argument) != cR1ReadyState) {
-		if (SimpleTimer::elapsedTimeMS() > cInitTimeout) {
+		if ((SimpleTimer::elapsedTimeMS() - startTime) > cInitTimeout) {
 			_error = Error_TimeOut;
 			goto initFail;
 		}
@@ -356,104 +767,119 @@ initFail:
 
 Status readDirectory()
 {
-	Status status;
-
-	// Wait until the block 0 read command has started.
-	if (startRead(0) == StatusError) {
-		return StatusError;
+	// Keep the card selected while reading all directory entries.
+	beginTransaction();
+	const Status status = readDirectoryEntries();
+	if (isReadRunning()) {
+		stopRead();
 	}
+	endTransaction();
+	return status;
+}
 
-	// The buffer to read the data.
-	uint8_t buffer[9];
-	std::memset(buffer, 0xaa, 9);
-	uint16_t byteCount = 4;
-	if (readData(buffer, &byteCount) == StatusError) {
-		return StatusError;
-	}
 
-	// Check the magic.
-	const char *magic = "HCDI";
-	if (std::strncmp(magic, reinterpret_cast<char*>(buffer), 4) != 0) {
-		_error = Error_UnknownMagic;
+Status readSegments(const DirectoryEntry *bank, const uint8_t *indexes, uint8_t *count, Segment *segments)
+{
+	if (bank->type != FileType_SoundBank) {
+		_error = Error_InvalidSoundBank;
 		return StatusError;
 	}
+	// Keep the card selected while reading the segment table.
+	beginTransaction();
+	const Status status = readSegmentTable(bank, indexes, count, segments);
+	if (isReadRunning()) {
+		stopRead();
+	}
+	endTransaction();
+	return status;
+}
 
-	// Read the directory.
-	uint32_t startBlock;
-	uint32_t fileSize;
-	uint8_t stringLength;
-	DirectoryEntry *newEntry = nullptr;
-	DirectoryEntry *lastEntry = nullptr;
-	do {
-		// Read the initial bytes.
-		byteCount = 9; // 2x 32bit integer + 1 byte string length.
-		if (readData(buffer, &byteCount) == StatusError) {
-			return StatusError;
-		}
-		// Interpret the bytes (not portable).
-		startBlock = getLittleEndianUInt32(buffer);
-		fileSize = getLittleEndianUInt32(buffer + 4);
-		stringLength = buffer[8];
-		if (startBlock > 0) {
-			newEntry = new DirectoryEntry;
-			newEntry->startBlock = startBlock;
-			newEntry->fileSize = fileSize;
-			newEntry->fileName = new char[stringLength+1];
-			std::memset(newEntry->fileName, 0, stringLength+1);
-			byteCount = stringLength;
-			if (readData(reinterpret_cast<uint8_t*>(newEntry->fileName), &byteCount) == StatusError) {
-				return StatusError;
-			}
-			newEntry->next = nullptr;
-			if (lastEntry != nullptr) {
-				lastEntry->next = newEntry;
-			} else {
-				_directoryEntry = newEntry;
-			}
-			lastEntry = newEntry;
-		}
-	} while(startBlock > 0);
 
-	// Success
-	return StatusReady;
+void beginTransaction()
+{
+	SimpleIO::setSdCardCS(true);
+	_transactionActive = true;
+}
+
+
+void endTransaction()
+{
+	_transactionActive = false;
+	SimpleIO::setSdCardCS(false);
+}
+
+
+uint32_t nameHash(const char *fileName)
+{
+	// FNV-1a, 32bit.
+	uint32_t hash = 0x811c9dc5U;
+	for (; *fileName != '\0'; ++fileName) {
+		hash ^= static_cast<uint8_t>(*fileName);
+		hash *= 0x01000193U;
+	}
+	return hash;
 }
 
 
 const DirectoryEntry* findFile(const char *fileName)
 {
-	DirectoryEntry *entry = _directoryEntry;
-	while (entry != 0) {
-		if (std::strcmp(fileName, entry->fileName) == 0) {
-			return entry;
+	const uint32_t hash = nameHash(fileName);
+	uint8_t first = 0;
+	if (_directorySorted) {
+		// Binary search for the first entry with the hash.
+		uint8_t last = _directoryEntryCount;
+		while (first < last) {
+			const uint8_t middle = (first + last) / 2;
+			if (_directoryEntries[middle].nameHash < hash) {
+				first = middle + 1;
+			} else {
+				last = middle;
+			}
+		}
+	}
+	for (uint8_t i = first; i < _directoryEntryCount; ++i) {
+		const DirectoryEntry &entry = _directoryEntries[i];
+		if (entry.nameHash == hash && std::strcmp(fileName, _namePool + entry.nameOffset) == 0) {
+			return &entry;
+		}
+		if (_directorySorted && entry.nameHash > hash) {
+			break;
 		}
-		entry = entry->next;
 	}
-	return 0;
+	return nullptr;
 }
 
 
 const DirectoryEntry* fileAtIndex(uint16_t index)
 {
-	const DirectoryEntry* result = _directoryEntry;
-	if (result == nullptr) {
+	if (index >= _directoryEntryCount) {
 		return nullptr;
 	}
-	for (uint16_t i = 0; i < index && result != nullptr; ++i) {
-		result = result->next;
-	}
-	return result;
+	return &_directoryEntries[index];
 }
 
 
 uint16_t fileCount()
 {
-	uint16_t count = 0;
-	const DirectoryEntry* result = _directoryEntry;
-	while (result != nullptr) {
-		++count;
-		result = result->next;
-	}
-	return count;
+	return _directoryEntryCount;
+}
+
+
+const char* getFileName(const DirectoryEntry *entry)
+{
+	return _namePool + entry->nameOffset;
+}
+
+
+uint16_t directoryMemoryUsed()
+{
+	return _directoryEntryCount * sizeof(DirectoryEntry) + _namePoolUsed;
+}
+
+
+uint16_t directoryMemorySize()
+{
+	return sizeof(_directoryEntries) + sizeof(_namePool);
 }
 
 
@@ -464,10 +890,12 @@ Status startRead(uint32_t block)
 	const uint8_t result = waitAndSendCommand(Cmd_ReadSingleBlock, block);
 	if (result != cR1ReadyState) {
 		_error = Error_ReadSingleBlockFailed;
+		_blockReadState = ReadStateEnd;
 		chipSelectEnd();
 		return StatusError;
 	}
 	// Reset the block byte count
+	_readBlock = block;
 	_blockByteCount = 0;
 	_blockReadState = ReadStateHeader;
 	_blockReadMode = ReadModeSingleBlock;
@@ -483,10 +911,12 @@ Status startMultiRead(uint32_t startBlock)
 	const uint8_t result = waitAndSendCommand(Cmd_ReadMultiBlock, startBlock);
 	if (result != cR1ReadyState) {
 		_error = Error_ReadSingleBlockFailed;
+		_blockReadState = ReadStateEnd;
 		chipSelectEnd();
 		return StatusError;
 	}
 	// Reset the block byte count
+	_readBlock = startBlock;
 	_blockByteCount = 0;
 	_blockReadState = ReadStateHeader;
 	_blockReadMode = ReadModeMultipleBlocks;
@@ -495,53 +925,84 @@ Status startMultiRead(uint32_t startBlock)
 }
 
 
+Status seek(uint32_t block, uint32_t offset)
+{
+	block += offset / cBlockSize;
+	const uint16_t blockOffset = static_cast<uint16_t>(offset % cBlockSize);
+	uint16_t byteCount;
+	if (isMultiReadRunning() &&
+		((block == _readBlock && blockOffset >= _blockByteCount) || block == _readBlock + 1)) {
+		// Skip forward in the running read.
+		byteCount = static_cast<uint16_t>((block - _readBlock) * cBlockSize + blockOffset - _blockByteCount);
+	} else {
+		if (isMultiReadRunning() && stopRead() == StatusError) {
+			return StatusError;
+		}
+		if (startMultiRead(block) == StatusError) {
+			return StatusError;
+		}
+		byteCount = blockOffset;
+	}
+	if (byteCount > 0 && readData(nullptr, &byteCount) == StatusError) {
+		return StatusError;
+	}
+	return StatusReady;
+}
+
+
 Status readData(uint8_t *buffer, uint16_t *byteCount)
 {
 	// variables
-	uint8_t result;
 	Status status = StatusReady;
 	uint16_t bytesToRead;
+	uint16_t bytesRead = 0;
+
+	// There is nothing to read after the end of the block or an error.
+	if (_blockReadState == ReadStateEnd) {
+		*byteCount = 0;
+		return StatusEndOfBlock;
+	}
 
 	// Start the read.
 	chipSelectBegin();
-	switch (_blockReadState) {
-	case ReadStateHeader:
-		result = waitForStatus(5000); // Wait 5s for the status byte.
-		if (result != cBlockDataStart) {
-			if (result == cBlockDataTimeOut) {
-				_error = Error_TimeOut;
-			} else {
-				_error = Error_ReadFailed;
+	// In multiple block mode, continue with the next block until all bytes are read.
+	while (bytesRead < *byteCount && status == StatusReady) {
+		switch (_blockReadState) {
+		case ReadStateHeader:
+			if (waitForDataBlock()) {
+				_blockReadState = ReadStateReadData;
+			} else if (_blockReadMode == ReadModeSingleBlock || resumeRead() == StatusError) {
+				_blockReadState = ReadStateEnd;
+				status = StatusError; // Failed.
 			}
-			_blockReadState = ReadStateEnd;
-			status = StatusError; // Failed.
-			*byteCount = 0;
 			break;
-		}
-		_blockReadState = ReadStateReadData;
-		// no break! continue with read data.
-	case ReadStateReadData:
-		bytesToRead = std::min(static_cast<uint16_t>(cBlockSize - _blockByteCount), *byteCount);
-		for (uint16_t i = 0; i < bytesToRead; ++i) {
-			buffer[i] = SimpleSPI::receive();
-		}
-		*byteCount = bytesToRead;
-		_blockByteCount += bytesToRead;
-		if (_blockByteCount >= cBlockSize) {
-			spiSkip(2);
-			_blockByteCount = 0;
-			if (_blockReadMode == ReadModeSingleBlock) {
-				_blockReadState = ReadStateEnd;
-				status = StatusEndOfBlock;
+		case ReadStateReadData:
+			bytesToRead = std::min(static_cast<uint16_t>(cBlockSize - _blockByteCount), static_cast<uint16_t>(*byteCount - bytesRead));
+			if (buffer != nullptr) {
+				SimpleSPI::receiveBlock(buffer + bytesRead, bytesToRead);
 			} else {
-				_blockReadState = ReadStateHeader;
+				SimpleSPI::skipBlock(bytesToRead);
+			}
+			bytesRead += bytesToRead;
+			_blockByteCount += bytesToRead;
+			if (_blockByteCount >= cBlockSize) {
+				spiSkip(2); // Skip the CRC.
+				_blockByteCount = 0;
+				++_readBlock;
+				if (_blockReadMode == ReadModeSingleBlock) {
+					_blockReadState = ReadStateEnd;
+					status = StatusEndOfBlock;
+				} else {
+					_blockReadState = ReadStateHeader;
+				}
 			}
+			break;
+		case ReadStateEnd:
+			status = StatusEndOfBlock;
+			break;
 		}
-		break;
-	case ReadStateEnd:
-		status = StatusEndOfBlock;
-		break;
 	}
+	*byteCount = bytesRead;
 	chipSelectEnd();
 	return status;
 }
@@ -551,10 +1012,12 @@ Status stopRead()
 {
 	if (_blockReadMode == ReadModeSingleBlock) {
 		if (_blockReadState != ReadStateEnd) {
-			// Make sure we read the rest of the data.
-			uint16_t byteCount = cBlockSize;
-			while (readData(0, &byteCount) != StatusEndOfBlock) {
-			}
+			// Make sure we read the rest of the data, an error also ends the block.
+			Status status;
+			do {
+				uint16_t byteCount = cBlockSize;
+				status = readData(nullptr, &byteCount);
+			} while (status == StatusReady);
 		}
 	} else {
 		// Send Command 12 in a special way
@@ -565,19 +1028,34 @@ Status stopRead()
 		SimpleSPI::send(0);
 		SimpleSPI::send(0);
 		SimpleSPI::send(0xff); // Fake CRC
+		_blockReadState = ReadStateEnd;
 		// Skip one byte
 		spiSkip(1);
 		uint8_t result;
 		for (uint8_t i = 0; ((result = SimpleSPI::receive()) & 0x80) && i < 0x10; ++i);
 		if (result != cR1ReadyState) {
+			chipSelectEnd();
 			return StatusError;
 		}
 		waitUntilReady(300);
+		chipSelectEnd();
 	}
 	return StatusReady;
 }
 
 
+uint16_t blockCount()
+{
+	return _blockCount;
+}
+
+
+uint16_t retryCount()
+{
+	return _retryCount;
+}
+
+
 Error error()
 {
 	return _error;
@@ -24,6 +24,9 @@ enum Error : uint8_t {
 	Error_ReadSingleBlockFailed = 5, ///< Failed to read a single block.
 	Error_ReadFailed = 6, ///< There was a problem reading data from the SD card.
 	Error_UnknownMagic = 7, ///< The "magic" value from the directory was wrong. The card is not formatted as expected.
+	Error_DirectoryFull = 8, ///< The directory has more files or longer names than fit into the directory memory.
+	Error_InvalidSoundBank = 9, ///< The file is no sound bank or the segment does not exist.
+	Error_InvalidDirectoryEntry = 10, ///< A directory entry has no sample rate, an unknown codec or file type.
 };
 
 /// The status of a command.
@@ -34,15 +37,53 @@ enum Status : uint8_t {
 	StatusEndOfBlock = 2, ///< Reached the end of the block.
 };
 
+/// The encoding of the samples in a file.
+///
+enum Codec : uint8_t {
+	Codec_Unsigned8 = 0, ///< Unsigned 8bit samples.
+	Codec_Level6 = 1, ///< Pre-quantized 6bit DAC values (0-63) in one byte, written to the DAC unchanged.
+	Codec_Packed6 = 2, ///< 6bit DAC values, four samples packed into three bytes, first sample in the low bits.
+	Codec_ImaAdpcm4 = 3, ///< 4bit IMA ADPCM, two samples per byte, first sample in the low nibble, no headers.
+};
+
+/// The type of a file.
+///
+enum FileType : uint8_t {
+	FileType_Sound = 0, ///< The file contains the samples of one sound.
+	FileType_SoundBank = 1, ///< The file contains a segment table and the samples of many sounds.
+};
+
 /// A single directory entry.
 ///
 struct DirectoryEntry {
 	uint32_t startBlock; ///< The start block of the file in blocks.
 	uint32_t fileSize; ///< The size of the file in bytes.
-	char *fileName; ///< Null terminated filename ASCII.
-	DirectoryEntry *next; ///< Pointer to the next entry, or a null pointer at the end.
+	uint32_t nameHash; ///< The hash of the file name, see nameHash().
+	uint16_t sampleRate; ///< The sample rate in Hz.
+	uint16_t nameOffset; ///< The offset of the file name in the name pool, see getFileName().
+	Codec codec; ///< The encoding of the samples.
+	FileType type; ///< The type of the file.
+};
+
+/// The position of a segment in a sound bank.
+///
+struct Segment {
+	uint32_t offset; ///< The offset of the segment from the start of the file in bytes.
+	uint32_t size; ///< The size of the segment in bytes.
 };
-	
+
+/// The sample rate for files without this information (version 1 directory).
+///
+const uint16_t cDefaultSampleRate = 44100;
+
+/// The maximum number of files in the directory.
+///
+const uint8_t cMaximumFileCount = 8;
+
+/// The size of the memory for all file names, including the null terminators.
+///
+const uint16_t cNamePoolSize = 80;
+
 /// Initialize the component and the SD-Card.
 /// This call needs some time until the SD-Card is ready for read.
 ///
@@ -52,20 +93,66 @@ Status initialize();
 
 /// Read the SD Card Directory in MicroDisk format
 ///
+/// Block 0 of the card contains the directory, all values are little endian.
+///
+/// Version 1 starts with the magic "HCDI", followed by variable length
+/// records: 32bit start block, 32bit file size, 8bit name length and the name.
+/// A record with start block 0 ends the directory.
+///
+/// Version 2 starts with the magic "HCD2", followed by the 16bit number of
+/// entries and the 16bit size of one record (40). Each record contains:
+/// 32bit name hash, 32bit start block, 32bit file size, 16bit sample rate,
+/// 8bit codec, 8bit file type, 32bit loop start, 32bit loop end and 16 bytes
+/// null padded name. The records are sorted by the name hash. The loop points
+/// are reserved for a later use and not read. A record with a sample rate of
+/// zero, an unknown codec or file type sets Error_InvalidDirectoryEntry.
+///
+/// The entries and the names are stored in statically allocated memory
+/// with space for cMaximumFileCount files and cNamePoolSize bytes of names.
+/// If the directory does not fit, the error is set to Error_DirectoryFull.
+///
 /// @return StatusReady on success, StatusError on any error.
 ///
 Status readDirectory();
 
+/// Read the positions of segments from a sound bank.
+///
+/// A sound bank starts with the magic "HCSB", followed by the 16bit number
+/// of segments and 16bit reserved. The table with one record for each segment
+/// follows, with the 32bit offset from the start of the file and the 32bit
+/// size in bytes. All segments use the codec and sample rate of the file.
+///
+/// The records are read in one pass if the indexes are ascending.
+///
+/// @param bank The directory entry of the sound bank.
+/// @param indexes The indexes of the segments to read, or nullptr to read the first segments in order.
+/// @param count in: The number of segments to read, out: the actual number of read segments.
+///    Without indexes, this is limited to the number of segments in the bank.
+/// @param segments The array for the read segments.
+/// @return StatusReady on success, StatusError on any error.
+///
+Status readSegments(const DirectoryEntry *bank, const uint8_t *indexes, uint8_t *count, Segment *segments);
+
+/// Calculate the hash for a file name.
+///
+/// This is the 32bit FNV-1a hash of the name bytes, which is also used to
+/// sort the version 2 directory.
+///
+/// @param fileName The null terminated file name.
+/// @return The hash value.
+///
+uint32_t nameHash(const char *fileName);
+
 /// Find a file with the given name.
 ///
+/// Uses a binary search for a sorted version 2 directory.
+///
 /// @return The found directory entry, or nullptr if no such file was found.
 ///
 const DirectoryEntry* findFile(const char *fileName);
 
 /// Get the file at the given index.
 ///
-/// This is a slow method. It has to iterate through the directory.
-///
 /// @param index The index of the file.
 /// @return The directory entry, or nullptr if the index was our of the valid range.
 ///
@@ -73,13 +160,43 @@ const DirectoryEntry* fileAtIndex(uint16_t index);
 
 /// Get the number of files in the directory.
 ///
-/// This is a slow method. It has to iterate through the while directory to count
-/// the number of entries.
-///
 /// @return The number of files in the directory.
 ///
 uint16_t fileCount();
 
+/// Get the name of a file.
+///
+/// @param entry The directory entry of the file.
+/// @return The null terminated file name in ASCII.
+///
+const char* getFileName(const DirectoryEntry *entry);
+
+/// Get the memory used by the directory.
+///
+/// @return The number of bytes used by the entries and the file names.
+///
+uint16_t directoryMemoryUsed();
+
+/// Get the memory reserved for the directory.
+///
+/// @return The size of the statically allocated directory memory in bytes.
+///
+uint16_t directoryMemorySize();
+
+/// Begin a transaction.
+///
+/// Asserts the chip select line and keeps it asserted until endTransaction()
+/// is called. All calls in between skip the chip select handling, use this
+/// for a stream of readData() calls, like when playing a sound file.
+///
+void beginTransaction();
+
+/// End a transaction.
+///
+/// Releases the chip select line.
+///
+void endTransaction();
+
 /// Start reading the given block.
 ///
 /// @param block The block in (512 byte blocks).
@@ -96,9 +213,32 @@ Status startRead(uint32_t block);
 ///
 Status startMultiRead(uint32_t startBlock);
 
+/// Start a multi block read at a byte position.
+///
+/// If a multi block read is running and the position is in its current or
+/// the next block, the read continues and the bytes in between are skipped.
+/// Otherwise the read is restarted at the block of the position and the bytes
+/// in front of the position are skipped.
+///
+/// @param block The block in (512 byte blocks), like the start block of a file.
+/// @param offset The offset from the start of this block in bytes.
+/// @return StatusError = there was an error,
+///    StatusReady = the read is at the position, call readData().
+///
+Status seek(uint32_t block, uint32_t offset);
+
 /// Read data if there is data ready to read.
 ///
-/// @param buffer The buffer to read the data into.
+/// In multiple block mode, the read continues with the next block until all
+/// requested bytes are read. The CRC and the start token between the blocks
+/// are handled in the same call.
+///
+/// If the card reports an error or times out at the start of a block, the
+/// multi block read is resumed at this block. The read is restarted first,
+/// then the card is re-initialized. An error is only returned if all of
+/// these attempts fail.
+///
+/// @param buffer The buffer to read the data into, or nullptr to skip the data.
 /// @param byteCount in: The number of bytes to read, out: the actual number of read bytes.
 /// @return StatusReady on success, StatusError is there was an error,
 ///     StatusEndOfBlock if the end of the block was reached.
@@ -113,6 +253,18 @@ Status readData(uint8_t *buffer, uint16_t *byteCount);
 ///
 Status stopRead();
 
+/// Get the number of data blocks received from the card.
+///
+/// This is a free running counter, use the difference of two values.
+///
+uint16_t blockCount();
+
+/// Get the number of attempts to resume a read after an error.
+///
+/// This is a free running counter, use the difference of two values.
+///
+uint16_t retryCount();
+
 /// Get the last error
 ///
 Error error();
@@ -13,6 +13,19 @@ namespace lr {
 namespace SimpleADC {
 
 
+/// The ADC channel for PTA1.
+///
+const uint8_t cSensorChannel = 0x01;
+
+/// The FTM0 overflow as hardware trigger source (SIM_SOPT0 ADHWT).
+///
+const uint8_t cTriggerSourceFTM0 = 0x01;
+
+/// The number of samples in one triggered batch.
+///
+uint8_t _batchSize = 0;
+
+
 void initialize()
 {
 	// Enable the ADC module.
@@ -38,8 +51,10 @@ void initialize()
 
 uint16_t getSample()
 {
+	// Disable the FIFO for a single conversion.
+	ADC_SC4 = 0;
 	// Start a conversion for PTA1
-	ADC_SC1 = ADC_SC1_ADCH(0x01);
+	ADC_SC1 = ADC_SC1_ADCH(cSensorChannel);
 	// Wait for the result
 	while ((ADC_SC1 & ADC_SC1_COCO_MASK) == 0) PE_NOP();
 	// Return the result.
@@ -47,5 +62,71 @@ uint16_t getSample()
 }
 
 
+/// Write the sensor channel into the FIFO once for each sample.
+///
+inline void fillChannelFifo(uint8_t count)
+{
+	for (uint8_t i = 0; i < count; ++i) {
+		ADC_SC1 = ADC_SC1_ADCH(cSensorChannel);
+	}
+}
+
+
+/// Wait until all conversions are complete and sum the results from the FIFO.
+///
+inline uint16_t readResultSum(uint8_t count)
+{
+	while ((ADC_SC1 & ADC_SC1_COCO_MASK) == 0) PE_NOP();
+	uint16_t sum = 0;
+	for (uint8_t i = 0; i < count; ++i) {
+		sum += (uint16_t)(ADC_R);
+	}
+	return sum;
+}
+
+
+uint16_t getSampleSum(uint8_t count)
+{
+	// Set the FIFO depth, the value is the depth minus one.
+	ADC_SC4 = ADC_SC4_AFDEP(count - 1);
+	// The conversions start if the FIFO contains a channel for each sample.
+	fillChannelFifo(count);
+	return readResultSum(count);
+}
+
+
+void startTriggeredBatches(uint8_t count)
+{
+	_batchSize = count;
+	// Use the overflow of FTM0 as hardware trigger.
+	SIM_SOPT0 = (SIM_SOPT0 & ~SIM_SOPT0_ADHWT_MASK) | SIM_SOPT0_ADHWT(cTriggerSourceFTM0);
+	// - One trigger converts all channels in the FIFO.
+	ADC_SC4 = ADC_SC4_AFDEP(count - 1)|ADC_SC4_HTRGME_MASK;
+	// - The trigger is masked while the result FIFO is not empty.
+	ADC_SC5 = ADC_SC5_HTRGMASKSEL_MASK;
+	// - Hardware trigger.
+	ADC_SC2 = ADC_SC2_ADTRG_MASK;
+	fillChannelFifo(count);
+}
+
+
+uint16_t readBatchSum()
+{
+	const uint16_t sum = readResultSum(_batchSize);
+	fillChannelFifo(_batchSize);
+	return sum;
+}
+
+
+void stopTriggeredBatches()
+{
+	ADC_SC2 = 0;
+	// Abort any conversion and reset the FIFO, before the FIFO is disabled.
+	ADC_SC1 = ADC_SC1_ADCH(0x1f);
+	ADC_SC5 = 0;
+	ADC_SC4 = 0;
+}
+
+
 }
 }
@@ -13,6 +13,11 @@ namespace lr {
 namespace SimpleADC {
 
 
+/// The maximum number of samples in one batch, the depth of the hardware FIFO.
+///
+const uint8_t cMaximumBatchSize = 8;
+
+
 /// Initialize the component.
 ///
 void initialize();
@@ -23,6 +28,41 @@ void initialize();
 ///
 uint16_t getSample();
 
+/// Get the sum of a batch of samples (blocking).
+///
+/// The channel is written into the FIFO once for each sample, so the hardware
+/// runs all conversions back to back. The results are read from the FIFO
+/// after the last conversion has completed.
+///
+/// @param count The number of samples, 2 up to cMaximumBatchSize.
+/// @return The sum of the 12bit samples.
+///
+uint16_t getSampleSum(uint8_t count);
+
+/// Start batches of samples, triggered by the timed interrupt timer.
+///
+/// Each overflow of the timer (FTM0) starts a batch of conversions in the
+/// hardware, there is no code involved in the timing of the samples. A
+/// trigger is ignored while the results of the last batch are not read, so
+/// the timer period has to be longer than the conversions of one batch.
+///
+/// @param count The number of samples in one batch, 2 up to cMaximumBatchSize.
+///
+void startTriggeredBatches(uint8_t count);
+
+/// Read the sum of a triggered batch.
+///
+/// Waits until the conversions are complete, reads the results and prepares
+/// the FIFO for the next trigger.
+///
+/// @return The sum of the 12bit samples.
+///
+uint16_t readBatchSum();
+
+/// Stop the triggered batches and return to software triggered conversions.
+///
+void stopTriggeredBatches();
+
 
 }
 }
@@ -40,27 +40,37 @@ const uint32_t cTotalBits        = cSdCardCsBits|cSignalBits|cAudioValueBits|cAu
 const uint32_t cTotalMask        = ~cTotalBits;
 
 
+/// The current 6bit audio value on the port.
+///
+uint8_t _audioValue = 0;
+
+
 void initialize()
 {
 	// Initialize the outputs
 	GPIOA_PDOR = ((GPIOA_PDOR & cTotalMask) | cSdCardCsMask);
 	// Set the output direction.
 	GPIOA_PDDR |= cTotalBits;
+	// Keep the current audio value for setAudioLevel().
+	_audioValue = static_cast<uint8_t>((GPIOA_PDOR & cAudioValueBits) >> cAudioValueShift);
 }
 
 
-void setAudioValue(uint8_t value)
+void setAudioLevel(uint8_t level)
 {
-	GPIOA_PDOR = (GPIOA_PDOR & cAudioValueMask) | (static_cast<uint32_t>(value & 0b111111U) << cAudioValueShift);
+	// Toggle the changed bits, this needs no read of the port.
+	level &= 0b111111U;
+	GPIOA_PTOR = static_cast<uint32_t>(level ^ _audioValue) << cAudioValueShift;
+	_audioValue = level;
 }
 
 
 void setAudioEnabled(bool enabled)
 {
 	if (!enabled) {
-		GPIOA_PDOR |= cAudioEnabledBits;
+		GPIOA_PSOR = cAudioEnabledBits;
 	} else {
-		GPIOA_PDOR &= cAudioEnabledMask;
+		GPIOA_PCOR = cAudioEnabledBits;
 	}
 }
 
@@ -68,9 +78,9 @@ void setAudioEnabled(bool enabled)
 void setSignal(bool enabled)
 {
 	if (enabled) {
-		GPIOA_PDOR |= cSignalBits;
+		GPIOA_PSOR = cSignalBits;
 	} else {
-		GPIOA_PDOR &= cSignalMask;
+		GPIOA_PCOR = cSignalBits;
 	}
 }
 
@@ -84,9 +94,9 @@ void toggleSignal()
 void setSdCardCS(bool enabled)
 {
 	if (!enabled) {
-		GPIOA_PDOR |= cSdCardCsBits;
+		GPIOA_PSOR = cSdCardCsBits;
 	} else {
-		GPIOA_PDOR &= cSdCardCsMask;
+		GPIOA_PCOR = cSdCardCsBits;
 	}
 }
 
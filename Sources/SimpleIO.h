@@ -19,9 +19,14 @@ void initialize();
 
 /// Set the value for the audio output.
 ///
-/// @param value The 6bit audio value.
+/// This is fast enough for the audio interrupt. It writes only the changed
+/// bits to the toggle register, without reading the port. All other outputs
+/// are changed with the set and clear registers, so this write can not
+/// interfere with them.
 ///
-void setAudioValue(uint8_t value);
+/// @param level The 6bit audio value, higher bits are ignored.
+///
+void setAudioLevel(uint8_t level);
 
 /// Enable the audio driver.
 ///
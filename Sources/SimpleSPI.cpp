@@ -60,8 +60,10 @@ void send(uint8_t byte)
 	while ((SPI0_S & SPI_S_SPTEF_MASK) == 0) PE_NOP();
 	// Now put the byte into the buffer
 	SPI0_D = byte;
-	// Wait until the byte was sent.
-	while ((SPI0_S & SPI_S_SPTEF_MASK) == 0) PE_NOP();
+	// Wait until the byte was sent and empty the read buffer. Otherwise the
+	// next receive() would read this byte while its own byte is still shifted.
+	while ((SPI0_S & SPI_S_SPRF_MASK) == 0) PE_NOP();
+	byte = SPI0_D;
 }
 
 
@@ -86,5 +88,85 @@ uint8_t receive()
 }
 
 
+/// Prepare a pipelined transfer.
+///
+/// Empties the receive buffer like receive() and queues the first dummy byte.
+///
+inline void beginPipelinedTransfer()
+{
+	// Check if the buffer is full.
+	if ((SPI0_S & SPI_S_SPRF_MASK) != 0) {
+		const uint8_t byte = SPI0_D; // dummy read to empty the read buffer.
+		(void)byte;
+	}
+	// Wait until the module is ready to write data, then queue the first dummy byte.
+	while ((SPI0_S & SPI_S_SPTEF_MASK) == 0) PE_NOP();
+	SPI0_D = 0xFFU;
+}
+
+
+/// Queue the next dummy byte, then read the byte received before.
+///
+inline uint8_t pipelinedExchange()
+{
+	// The transmit buffer gets empty as soon the previous byte moves to the shift register.
+	while ((SPI0_S & SPI_S_SPTEF_MASK) == 0) PE_NOP();
+	// While two bytes are on the way, an interrupt would overrun the receive buffer.
+	EnterCritical();
+	SPI0_D = 0xFFU;
+	// Read the byte received before, while the queued one is shifted.
+	while ((SPI0_S & SPI_S_SPRF_MASK) == 0) PE_NOP();
+	const uint8_t byte = SPI0_D;
+	ExitCritical();
+	return byte;
+}
+
+
+/// Read the byte of the last queued dummy byte.
+///
+inline uint8_t endPipelinedTransfer()
+{
+	while ((SPI0_S & SPI_S_SPRF_MASK) == 0) PE_NOP();
+	return SPI0_D;
+}
+
+
+void receiveBlock(uint8_t *buffer, uint16_t length)
+{
+	if (length == 0) {
+		return;
+	}
+	beginPipelinedTransfer();
+	uint16_t remaining = length - 1;
+	// Unrolled loop for four bytes in each step.
+	while (remaining >= 4) {
+		buffer[0] = pipelinedExchange();
+		buffer[1] = pipelinedExchange();
+		buffer[2] = pipelinedExchange();
+		buffer[3] = pipelinedExchange();
+		buffer += 4;
+		remaining -= 4;
+	}
+	while (remaining > 0) {
+		*buffer++ = pipelinedExchange();
+		--remaining;
+	}
+	*buffer = endPipelinedTransfer();
+}
+
+
+void skipBlock(uint16_t length)
+{
+	if (length == 0) {
+		return;
+	}
+	beginPipelinedTransfer();
+	for (uint16_t i = 1; i < length; ++i) {
+		(void)pipelinedExchange();
+	}
+	(void)endPipelinedTransfer();
+}
+
+
 }
 }
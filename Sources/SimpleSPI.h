@@ -37,6 +37,25 @@ void send(uint8_t byte);
 ///
 uint8_t receive();
 
+/// Receive a block of bytes from the SPI bus.
+///
+/// The next dummy byte is queued in the transmit buffer while the previous
+/// byte is still shifted, so the bus runs without gaps between the bytes.
+/// The received bytes are the same as from calling receive() length times.
+///
+/// @param buffer The buffer for the received bytes.
+/// @param length The number of bytes to receive.
+///
+void receiveBlock(uint8_t *buffer, uint16_t length);
+
+/// Skip a block of bytes from the SPI bus.
+///
+/// Works like receiveBlock(), but discards the received bytes.
+///
+/// @param length The number of bytes to skip.
+///
+void skipBlock(uint16_t length);
+
 /// Change the SPI speed.
 ///
 /// @param speed The new speed.
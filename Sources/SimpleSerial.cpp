@@ -4,6 +4,8 @@
 #include "SimpleSerial.h"
 
 
+#include "RingBuffer.h"
+
 #include <cstring>
 
 #include <Cpu.h>
@@ -18,25 +20,14 @@ const char *hexChars = "0123456789abcdef";
 }
 
 
-/// The mask to keep the input buffer index in range
-///
-const uint8_t _inputBufferIndexMask = 0x0f;
-
 /// The input buffer.
+/// Filled in the receive interrupt and emptied in the main loop.
 ///
-char _inputBuffer[cInputBufferSize];
-
-/// The index where to read the next character.
-///
-volatile uint8_t _inputReadIndex = 0;
-
-/// The index where the next character is to send back to the user.
-///
-volatile uint8_t _loopBackReadIndex = 0;
+RingBuffer<char, cInputBufferSize> _inputBuffer;
 
-/// The number of bytes currently in the input buffer.
+/// The number of characters in the input buffer which were sent back to the user.
 ///
-volatile uint8_t _inputCharacterCount = 0;
+uint8_t _loopBackCount = 0;
 
 
 void initialize()
@@ -109,55 +100,37 @@ void sendLine(const char *text)
 }
 
 
-char getInputCharacter(uint8_t index)
-{
-	index += _inputReadIndex;
-	index &= _inputBufferIndexMask;
-	return _inputBuffer[index];
-}
-
-
-bool hasLine()
+/// Get the length of the first line in the input buffer.
+///
+/// @param characterCount The number of characters in the input buffer.
+/// @return The number of characters including the newline, or zero if there is no full line.
+///
+uint8_t lineLength(uint8_t characterCount)
 {
-	if (_inputCharacterCount == 0) {
-		return false;
-	}
-	if (_inputCharacterCount == cInputBufferSize) {
-		return true;
+	if (characterCount == cInputBufferSize) {
+		return characterCount;
 	}
-	for (uint8_t i = 0; i < _inputCharacterCount; ++i) {
-		const char c = getInputCharacter(i);
-		if (c == '\n') {
-			return true;
+	for (uint8_t i = 0; i < characterCount; ++i) {
+		if (_inputBuffer.peek(i) == '\n') {
+			return i + 1;
 		}
 	}
-	return false;
-}
-
-
-void increaseReadIndex(uint8_t count) {
-	_inputReadIndex = ((_inputReadIndex + count) & _inputBufferIndexMask);
-	_inputCharacterCount -= count;
+	return 0;
 }
 
 
 bool loopBackCharacter()
 {
-	bool hasMoreCharacters = false;
-	EnterCritical();
-	const uint8_t aheadFromInput = ((_loopBackReadIndex - _inputReadIndex) & _inputBufferIndexMask);
-	const uint8_t outstandingCharacters = _inputCharacterCount - aheadFromInput;
-	if (outstandingCharacters > 0) {
-		const char c = _inputBuffer[_loopBackReadIndex];
-		if (c == '\n') {
-			sendCharacter('\r');
-		}
-		sendCharacter(c);
-		_loopBackReadIndex = ((_loopBackReadIndex + 1) & _inputBufferIndexMask);
-		hasMoreCharacters = true;
+	if (_loopBackCount >= _inputBuffer.size()) {
+		return false;
+	}
+	const char c = _inputBuffer.peek(_loopBackCount);
+	if (c == '\n') {
+		sendCharacter('\r');
 	}
-	ExitCritical();
-	return hasMoreCharacters;
+	sendCharacter(c);
+	++_loopBackCount;
+	return true;
 }
 
 
@@ -166,28 +139,23 @@ bool readLine(char *buffer)
 	// Send received characters from the buffer back to the serial line.
 	while (loopBackCharacter()) PE_NOP();
 	// Check if we can read a full line.
-	EnterCritical();
-	bool result = false;
-	if (hasLine()) {
-		memset(buffer, 0, cInputBufferSize);
-		uint8_t readCharacters = 0;
-		for (uint8_t i = 0; i < _inputCharacterCount; ++i) {
-			const char c = getInputCharacter(i);
-			++readCharacters;
-			if (c == '\n') {
-				break;
-			}
-			if (c >= 0x20) {
-				*buffer = c;
-				++buffer;
-			}
+	const uint8_t readCharacters = lineLength(static_cast<uint8_t>(_inputBuffer.size()));
+	if (readCharacters == 0) {
+		return false;
+	}
+	memset(buffer, 0, cInputBufferSize);
+	for (uint8_t i = 0; i < readCharacters; ++i) {
+		const char c = _inputBuffer.peek(i);
+		if (c >= 0x20) {
+			*buffer = c;
+			++buffer;
 		}
-		*buffer = '\0';
-		result = true;
-		increaseReadIndex(readCharacters);
 	}
-	ExitCritical();
-	return result;
+	*buffer = '\0';
+	_inputBuffer.commitRead(readCharacters);
+	// A newline can arrive after the loop back, it was not sent back in this case.
+	_loopBackCount = (_loopBackCount > readCharacters ? _loopBackCount - readCharacters : 0);
+	return true;
 }
 
 
@@ -212,16 +180,14 @@ PE_ISR(lrOnUART)
 	}
 
 	// Make sure the last character can only be a newline
-	if (_inputCharacterCount == (cInputBufferSize-2) && c != '\n') {
+	const uint16_t characterCount = _inputBuffer.size();
+	if (characterCount == (cInputBufferSize-2) && c != '\n') {
 		return;
 	}
 
 	// Check if there is space in the input buffer.
-	if (_inputCharacterCount < (cInputBufferSize-1)) {
-		// Calculate the position where to write the character.
-		const uint8_t index = ((_inputReadIndex+_inputCharacterCount) & _inputBufferIndexMask);
-		_inputBuffer[index] = c;
-		++_inputCharacterCount;
+	if (characterCount < (cInputBufferSize-1)) {
+		_inputBuffer.push(c);
 	}
 }
 
@@ -57,6 +57,22 @@ uint32_t elapsedTimeMS()
 }
 
 
+uint32_t ticks()
+{
+	uint32_t counter;
+	uint32_t count;
+	EnterCritical();
+	counter = (uint32_t)_counter;
+	count = FTM2_CNT;
+	// Count an overflow which is not handled by the interrupt yet.
+	if ((FTM2_SC & FTM_SC_TOF_MASK) != 0 && count < 0x8000) {
+		++counter;
+	}
+	ExitCritical();
+	return (counter << 16) | count;
+}
+
+
 void waitMS(uint32_t milliseconds)
 {
 	reset();
@@ -13,6 +13,11 @@ namespace lr {
 namespace SimpleTimer {
 
 
+/// The number of timer ticks in one microsecond (the bus clock).
+///
+const uint32_t cTicksPerMicrosecond = 24;
+
+
 /// Initialize the timer
 ///
 void initialize();
@@ -26,6 +31,13 @@ void reset();
 ///
 uint32_t elapsedTimeMS();
 
+/// Get the timer ticks since the last reset.
+///
+/// The value has the resolution of the bus clock and wraps after ~178s.
+/// Use the difference of two values to measure short durations.
+///
+uint32_t ticks();
+
 /// Wait a number of milliseconds
 /// The time is just an approximation, 100ms => real ~85ms
 ///
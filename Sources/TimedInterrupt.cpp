@@ -16,8 +16,21 @@ namespace TimedInterrupt {
 void ignoreCallback() {}
 
 
+/// The configurations for the fixed frequencies.
+///
+const Configuration cFrequencyConfigurations[] = {
+	configurationForMilliHertz(500), // Frequency_05Hz
+	configurationForMilliHertz(3000), // Frequency_3Hz
+	configurationForMilliHertz(5000), // Frequency_5Hz
+	configurationForMilliHertz(44100000), // Frequency_44100Hz
+};
+
+
+static_assert(configurationForFrequency(44100).modulo == 543, "Unexpected configuration for 44.1kHz.");
+
+
 Callback _callback = &ignoreCallback;
-Frequency _frequency = Frequency_3Hz;
+Configuration _configuration = cFrequencyConfigurations[Frequency_3Hz];
 
 
 void initialize()
@@ -42,7 +55,25 @@ void setCallback(Callback callback)
 
 void setFrequency(Frequency frequency)
 {
-	_frequency = frequency;
+	_configuration = cFrequencyConfigurations[frequency];
+}
+
+
+void setConfiguration(const Configuration &configuration)
+{
+	_configuration = configuration;
+}
+
+
+void setFrequency(uint32_t frequency)
+{
+	_configuration = configurationForFrequency(frequency);
+}
+
+
+void callCallback()
+{
+	_callback();
 }
 
 
@@ -50,33 +81,10 @@ void start()
 {
 	// Reset the counter
 	FTM0_CNT = 0;
-	// Set the frequency
-	switch (_frequency) {
-	case Frequency_05Hz:
-		// Set the modulo register for the frequency
-		FTM0_MOD = FTM_MOD_MOD(0xffff); // 37000 / 25856 = ~0.5Hz
-		// Activate the interrupt and set the fixed frequency (37kHz) as source for the counter.
-		FTM0_SC = (FTM_SC_TOIE_MASK | FTM_SC_CLKS(0x02) | FTM_SC_PS(0x00));
-		break;
-	case Frequency_3Hz:
-		// Set the modulo register for the frequency
-		FTM0_MOD = FTM_MOD_MOD(0x30D4); // 37000 / 12499 = ~3Hz
-		// Activate the interrupt and set the fixed frequency (37kHz) as source for the counter.
-		FTM0_SC = (FTM_SC_TOIE_MASK | FTM_SC_CLKS(0x02) | FTM_SC_PS(0x00));
-		break;
-	case Frequency_5Hz:
-		// Set the modulo register for the frequency
-		FTM0_MOD = FTM_MOD_MOD(0x1D4C); // 37000 / 7499 = ~5Hz
-		// Activate the interrupt and set the fixed frequency (37kHz) as source for the counter.
-		FTM0_SC = (FTM_SC_TOIE_MASK | FTM_SC_CLKS(0x02) | FTM_SC_PS(0x00));
-		break;
-	case Frequency_44100Hz:
-		// Set the modulo register for the frequency
-		FTM0_MOD = FTM_MOD_MOD(543); // 48MHz / 2 / 544 = ~44100Hz
-		// Activate the interrupt and set the fixed frequency (37kHz) as source for the counter.
-		FTM0_SC = (FTM_SC_TOIE_MASK | FTM_SC_CLKS(0x01) | FTM_SC_PS(0x00));
-		break;
-	}
+	// Set the modulo register for the frequency
+	FTM0_MOD = FTM_MOD_MOD(_configuration.modulo);
+	// Activate the interrupt and set the clock source and prescaler for the counter.
+	FTM0_SC = (FTM_SC_TOIE_MASK | FTM_SC_CLKS(_configuration.clockSource) | FTM_SC_PS(_configuration.prescaler));
 }
 
 
@@ -92,17 +100,3 @@ void stop()
 }
 }
 
-
-/// The interrupt function used in the "Vectors.c" file.
-#ifdef __cplusplus
-extern "C"
-#endif
-PE_ISR(lrOnFTM0)
-{
-	// Reset the TOF bit.
-	FTM0_SC &= (uint32_t)(~(uint32_t)FTM_SC_TOF_MASK);
-	// Call the callback.
-	lr::TimedInterrupt::_callback();
-}
-
-
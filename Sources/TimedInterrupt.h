@@ -21,19 +21,100 @@ typedef void(*Callback)();
 enum Frequency {
 	Frequency_05Hz, // Used for maintenance mode blink.
 	Frequency_3Hz, // Used for error blink.
-	Frequency_5Hz, // Used for detection.
+	Frequency_5Hz, // The detection rate, the detector uses its own phase timing.
 	Frequency_44100Hz // Used to play sound.
 };
 
 
+/// The clock of the timer if the system clock is selected (the bus clock).
+///
+const uint32_t cSystemClock = 24000000;
+
+/// The clock of the timer if the fixed frequency clock is selected.
+///
+const uint32_t cFixedClock = 37000;
+
+/// The clock source of the timer (the CLKS value).
+///
+enum ClockSource : uint8_t {
+	ClockSource_System = 1, ///< The bus clock, 24MHz.
+	ClockSource_Fixed = 2, ///< The fixed frequency clock, 37kHz.
+};
+
+/// The configuration of the timer for a frequency.
+///
+struct Configuration {
+	uint16_t modulo; ///< The value for the modulo register.
+	ClockSource clockSource; ///< The clock source.
+	uint8_t prescaler; ///< The prescaler, the clock is divided by 2^prescaler.
+};
+
+
+/// Get the number of counter ticks for one period.
+///
+constexpr uint64_t ticksForPeriod(uint32_t clock, uint8_t prescaler, uint64_t milliHertz)
+{
+	return ((static_cast<uint64_t>(clock >> prescaler) * 1000) + (milliHertz / 2)) / milliHertz;
+}
+
+/// Calculate the configuration, starting with the given clock and prescaler.
+///
+/// The system clock is preferred for the best resolution. The prescaler is
+/// increased until one period fits into the 16bit counter. If even the
+/// largest prescaler is not enough, the fixed frequency clock is used.
+///
+constexpr Configuration configurationForMilliHertz(uint64_t milliHertz, ClockSource clockSource = ClockSource_System, uint8_t prescaler = 0)
+{
+	return (ticksForPeriod((clockSource == ClockSource_System) ? cSystemClock : cFixedClock, prescaler, milliHertz) <= 0x10000) ?
+		Configuration{static_cast<uint16_t>(ticksForPeriod((clockSource == ClockSource_System) ? cSystemClock : cFixedClock, prescaler, milliHertz) - 1),
+			clockSource, prescaler} :
+		(prescaler < 7) ? configurationForMilliHertz(milliHertz, clockSource, prescaler + 1) :
+		(clockSource == ClockSource_System) ? configurationForMilliHertz(milliHertz, ClockSource_Fixed, 0) :
+		Configuration{0xffff, ClockSource_Fixed, 7}; // The lowest possible frequency.
+}
+
+/// Calculate the timer configuration for a frequency.
+///
+/// This is evaluated at compile time if the frequency is a constant.
+///
+/// @param frequency The frequency in Hz, 1Hz up to the system clock.
+/// @return The configuration with the closest possible frequency.
+///
+constexpr Configuration configurationForFrequency(uint32_t frequency)
+{
+	return configurationForMilliHertz(static_cast<uint64_t>(frequency) * 1000);
+}
+
+/// Calculate the timer configuration for a period.
+///
+/// This is evaluated at compile time if the period is a constant.
+///
+/// @param microseconds The period in microseconds.
+/// @return The configuration with the closest possible period.
+///
+constexpr Configuration configurationForPeriod(uint32_t microseconds)
+{
+	return configurationForMilliHertz(1000000000ULL / microseconds);
+}
+
+
 /// Initialize the timed interrupt component.
 ///
 void initialize();
 
 /// Set a callback for the interrupt.
 ///
+/// The callback is called if the handler bound with LR_BIND_TIMED_INTERRUPT()
+/// does not handle the interrupt (see "TimedInterruptHandler.h").
+///
 void setCallback(Callback callback);
 
+/// Call the callback.
+///
+/// This is used by the bound interrupt handler.
+///
+void callCallback();
+
 /// Set the frequency of the interrupt
 ///
 /// You must set the frequency while this component is stopped. The frequency
@@ -41,6 +122,34 @@ void setCallback(Callback callback);
 ///
 void setFrequency(Frequency frequency);
 
+/// Set the configuration of the timer.
+///
+/// Like setFrequency(), you must set the configuration while this component
+/// is stopped.
+///
+void setConfiguration(const Configuration &configuration);
+
+/// Set any frequency for the interrupt.
+///
+/// The configuration is calculated at runtime, use the template version for
+/// constant frequencies.
+///
+/// @param frequency The frequency in Hz.
+///
+void setFrequency(uint32_t frequency);
+
+/// Set a constant frequency for the interrupt.
+///
+/// The configuration is calculated at compile time.
+///
+template<uint32_t tFrequency>
+inline void setFrequency()
+{
+	static_assert(tFrequency > 0, "The frequency must not be zero.");
+	constexpr Configuration configuration = configurationForFrequency(tFrequency);
+	setConfiguration(configuration);
+}
+
 /// Start generating interrupts
 ///
 void start();
@@ -0,0 +1,65 @@
+#pragma once
+//
+// PissOff Project for BoldPort Club
+// (c)2016 by Lucky Resistor. http://luckyresistor.me
+// Licensed under the MIT license. See file LICENSE for details.
+//
+
+
+#include "TimedInterrupt.h"
+
+#include <Cpu.h>
+
+
+namespace lr {
+namespace TimedInterrupt {
+
+
+/// Clear the overflow flag of the timer.
+///
+inline void acknowledgeInterrupt()
+{
+	FTM0_SC &= (uint32_t)(~(uint32_t)FTM_SC_TOF_MASK);
+}
+
+
+/// Get the counter ticks since the last overflow.
+///
+/// Called in the interrupt, this is the latency since the interrupt was
+/// requested, in ticks of the configured clock.
+///
+inline uint16_t ticksSinceOverflow()
+{
+	return static_cast<uint16_t>(FTM0_CNT);
+}
+
+
+/// Handle the interrupt with a handler which is bound at compile time.
+///
+/// The handler is called directly and can be inlined. If it returns false,
+/// the callback set with setCallback() is called.
+///
+template<bool (*tHandler)()>
+inline void handleInterrupt()
+{
+	acknowledgeInterrupt();
+	if (!tHandler()) {
+		callCallback();
+	}
+}
+
+
+}
+}
+
+
+/// Bind a handler to the timer interrupt at compile time.
+///
+/// Use this macro in exactly one module, outside of any namespace. It defines
+/// the interrupt function used in the "Vectors.c" file.
+///
+/// @param handler A function `bool handler()` which returns false if the
+///    callback set with setCallback() should handle the interrupt.
+///
+#define LR_BIND_TIMED_INTERRUPT(handler) \
+	extern "C" PE_ISR(lrOnFTM0) { lr::TimedInterrupt::handleInterrupt<handler>(); }